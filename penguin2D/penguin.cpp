@@ -46,12 +46,8 @@
 #include <math.h>
 
 #ifndef _WIN32
-#include <unistd.h>
-#else
-void usleep(unsigned int nanosec)
-{
-    Sleep(nanosec / 1000);
-}
+#include <sys/time.h>
+#include <time.h>
 #endif
 
 
@@ -111,6 +107,17 @@ int Win[2];                 // window (x,y) = (width, height) size, the window i
 int animate_mode = 0;       // 0 = no animation, 1 = animation
 int animation_frame = 0;      // Specify current frame of animation
 
+// Frame scheduling (see scheduleFrame())
+// animation_frame is the number of frames of FRAMES_PER_SECOND since the
+// animation started, at animation_start seconds of wall time. A GLUT timer
+// wakes the event loop at the next frame deadline, so input is handled while
+// waiting, and a late frame skips straight to the frame that is due.
+const int FRAMES_PER_SECOND = 60;           // the refresh rate of most displays
+const double OSCILLATION_PER_SECOND = 2.0;  // radians of the animation per second
+double animation_start = 0;
+int frame_timer_run = 0;    // animation run the pending frame timer belongs to;
+                            // timers of a stopped run are ignored
+
 // Joint parameters
 const float JOINT_MIN = -45.0f;
 const float JOINT_MAX =  45.0f;
@@ -196,6 +203,11 @@ void myReshape(int w, int h);  // used to resize Window
 void animate();
 void display(void);
 
+// Frame scheduling
+double wallTime();
+void scheduleFrame();
+void frameTimer(int run);
+
 // Callback for handling events in glui
 void GLUI_Control(int id);
 
@@ -412,13 +424,14 @@ void animateButton(int)
   glui->sync_live();
 
   animation_frame = 0;
+  frame_timer_run++;
   if(animate_mode == 1) {
-    // start animation
-    GLUI_Master.set_glutIdleFunc(animate);
-  } else {
-    // stop animation
-    GLUI_Master.set_glutIdleFunc(NULL);
+    // start animation: draw the first frame and schedule the next one
+    animation_start = wallTime();
+    animate();
+    scheduleFrame();
   }
+  // to stop animation, the new run is enough to ignore the pending timer
 }
 
 //---------------------------------------------------------------------------------------------
@@ -521,8 +534,50 @@ void initGl(void)
 //---------------------------------------------------------------------------------------------
 
 
-// This function callback idle function for animating the scene
-// It animates the character's joints
+// This function returns the wall time in seconds, from a clock that only
+// moves forward if the system has one.
+double wallTime()
+{
+#ifdef _WIN32
+    return GetTickCount() / 1000.0;
+#elif defined(CLOCK_MONOTONIC)
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+#else
+    timeval now;
+    gettimeofday(&now, NULL);
+    return now.tv_sec + now.tv_usec / 1e6;
+#endif
+}
+
+// This function schedules frameTimer() for the deadline of the frame after
+// animation_frame, or as soon as possible if it has passed.
+void scheduleFrame()
+{
+    double deadline = animation_start + double(animation_frame + 1) / FRAMES_PER_SECOND;
+    double wait = deadline - wallTime();
+    unsigned int msecs = wait > 0 ? (unsigned int) ceil(wait * 1000) : 0;
+    glutTimerFunc(msecs, frameTimer, frame_timer_run);
+}
+
+// This function is the GLUT timer callback of the animation.
+// It moves animation_frame to the frame due at the current wall time, which
+// skips the frames that were missed, animates it, and schedules the next one.
+void frameTimer(int run)
+{
+    if(run != frame_timer_run)
+        return;
+
+    int due = int((wallTime() - animation_start) * FRAMES_PER_SECOND);
+    if(due != animation_frame) {
+        animation_frame = due;
+        animate();
+    }
+    scheduleFrame();
+}
+
+// This function animates the character's joints for animation_frame
 void animate()
 {
 
@@ -581,7 +636,7 @@ Joint* mouthJoint;  // Joint connecting the head to mouth
 */
 
     // Update geometry
-    double oscillate = (sin(animation_frame * 0.1) + 1.0) / 2.0;
+    double oscillate = (sin(animation_frame * OSCILLATION_PER_SECOND / FRAMES_PER_SECOND) + 1.0) / 2.0;
 
     // Another convenience macro that will change the value of @obj->attr@
     // based on the current frame.
@@ -602,15 +657,6 @@ Joint* mouthJoint;  // Joint connecting the head to mouth
     // the callback).
     glutSetWindow(windowID);
     glutPostRedisplay();
-
-    // Increment the frame number.
-
-    // Wait 50 ms between frames (20 frames per second)
-    // Run at 20 FPS by sleeping before this animate function returns and allow main function to call animate() again. 
-    animation_frame++;
-    usleep(50000);
-
-
 }
 
 //---------------------------------------------------------------------------------------------
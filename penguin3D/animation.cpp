@@ -0,0 +1,309 @@
+#include "animation.h"
+#include "keyframefile.h"
+#include "spline.h"
+#include <string.h>
+#include <algorithm>
+#include <assert.h>
+
+TrackView::TrackView(const Keyframe *keys, int last) {
+    times_ = keys ? reinterpret_cast<const char *>(keys[0].getTimePtr()) : 0;
+    poses_ = keys ? reinterpret_cast<const char *>(
+                        keys[0].getDOFVector().getData()) : 0;
+    timeStride_ = sizeof(Keyframe);
+    poseStride_ = sizeof(Keyframe);
+    last_ = last;
+}
+
+TrackView::TrackView(const float *times, const float *poses, int last) {
+    times_ = reinterpret_cast<const char *>(times);
+    poses_ = reinterpret_cast<const char *>(poses);
+    timeStride_ = sizeof(float);
+    poseStride_ = Keyframe::NUM_JOINT_ENUM * sizeof(float);
+    last_ = last;
+}
+
+TrackView::TrackView(const float *times, ptrdiff_t timeStride,
+                     const float *poses, ptrdiff_t poseStride, int last) {
+    times_ = reinterpret_cast<const char *>(times);
+    poses_ = reinterpret_cast<const char *>(poses);
+    timeStride_ = timeStride;
+    poseStride_ = poseStride;
+    last_ = last;
+}
+
+int findKeyframe(const TrackView &track, float time) {
+    // Invariant: time(low - 1) < time <= time(high), where time(-1) is
+    // earlier and time(last + 1) is later than any time.
+    int low = 0;
+    int high = track.last() + 1;
+    while (low < high) {
+        int middle = low + (high - low) / 2;
+        if (track.time(middle) < time)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+PlaybackCursor::PlaybackCursor() {
+    index_ = 0;
+}
+
+// Returns true if @index@ is the result of findKeyframe for the given time.
+static bool isKeyframeFor(const TrackView &track, float time, int index) {
+    return (index == 0 || track.time(index - 1) < time) &&
+           (index > track.last() || time <= track.time(index));
+}
+
+int PlaybackCursor::Find(const TrackView &track, float time) {
+    int last = track.last();
+    if (index_ > last + 1)
+        index_ = last + 1;
+
+    // Most frames stay in the same segment or move on to the next one.
+    if (!isKeyframeFor(track, time, index_)) {
+        if (index_ <= last && isKeyframeFor(track, time, index_ + 1))
+            index_++;
+        else
+            index_ = findKeyframe(track, time);
+    }
+    return index_;
+}
+
+void PlaybackCursor::Reset() {
+    index_ = 0;
+}
+
+SplineSegment keyframeSegment(const TrackView &track, int i) {
+    // Get appropriate data points and tangent vectors
+    // for computing the interpolation
+    int last = track.last();
+    SplineSegment segment;
+    segment.p0 = track.pose(i - 1);
+    segment.p1 = track.pose(i);
+
+    if ( i == 1 ) {                         // special case - at beginning of spline
+        segment.prev = segment.p0;
+        segment.s0 = 1;
+    } else {
+        segment.prev = track.pose(i - 2);
+        segment.s0 = 0.5;
+    }
+
+    if ( i == last ) {                      // special case - at end of spline
+        segment.next = segment.p1;
+        segment.s1 = 1;
+    } else {
+        segment.next = track.pose(i + 1);
+        segment.s1 = 0.5;
+    }
+    return segment;
+}
+
+// Writes the pose of the track at the given time to @pose@.
+static void samplePose(const TrackView &track, float time,
+                       PlaybackCursor *cursor, float *pose) {
+    const int dofs = Keyframe::NUM_JOINT_ENUM;
+    int last = track.last();
+
+    // Need to find the keyframes bewteen which
+    // the supplied time lies:
+    //    track.time(i-1) < time <= track.time(i)
+    //
+    int i = cursor ? cursor->Find(track, time) : findKeyframe(track, time);
+
+    // If time is before or at first defined keyframe, then
+    // just use first keyframe pose
+    if ( i == 0 ) {
+        memcpy(pose, track.pose(0), dofs * sizeof(float));
+        return;
+    }
+
+    // If time is beyond last defined keyframe, then just
+    // use last keyframe pose
+    if ( i > last ) {
+        memcpy(pose, track.pose(last), dofs * sizeof(float));
+        return;
+    }
+
+    // Need to normalize time to (0, 1]
+    time = (time - track.time(i - 1)) / (track.time(i) - track.time(i - 1));
+
+    evaluateSpline(keyframeSegment(track, i), time, dofs, pose);
+}
+
+Keyframe::Pose interpolateKeyframes(const TrackView &track, float time,
+                                    PlaybackCursor *cursor) {
+    Keyframe::Pose pose;
+    samplePose(track, time, cursor, pose.getData());
+    return pose;
+}
+
+void interpolateKeyframes(const TrackView &track, const float *times,
+                          int count, float *poses, PlaybackCursor *cursor) {
+    for (int i = 0; i < count; i++) {
+        samplePose(track, times[i], cursor,
+                   poses + i * Keyframe::NUM_JOINT_ENUM);
+    }
+}
+
+// Orders keyframes by time.
+static bool earlier(const Keyframe &a, const Keyframe &b) {
+    return a.getTime() < b.getTime();
+}
+
+KeyframeTrack::KeyframeTrack() : keys_(), file_(0) { }
+
+KeyframeTrack::~KeyframeTrack() {
+    delete file_;
+}
+
+int KeyframeTrack::size() const {
+    return file_ ? file_->size() : int(keys_.size());
+}
+
+int KeyframeTrack::last() const {
+    return size() - 1;
+}
+
+float KeyframeTrack::duration() const {
+    return size() > 0 ? view().time(last()) : 0;
+}
+
+TrackView KeyframeTrack::view() const {
+    if (file_)
+        return TrackView(file_->times(), file_->poses(), last());
+    return TrackView(keys_.empty() ? 0 : &keys_[0], last());
+}
+
+Keyframe KeyframeTrack::operator[](int index) const {
+    assert(index >= 0 && index < size());
+    if (!file_)
+        return keys_[index];
+
+    Keyframe keyframe;
+    keyframe.setID(index);
+    keyframe.setTime(file_->times()[index]);
+    memcpy(keyframe.getDOFPtr(0), view().pose(index),
+           Keyframe::NUM_JOINT_ENUM * sizeof(float));
+    return keyframe;
+}
+
+bool KeyframeTrack::Map(const char *filename) {
+    KeyframeFile *file = new KeyframeFile();
+    if (!file->Open(filename)) {
+        delete file;
+        return false;
+    }
+
+    // Free the keyframes rather than just clearing them.
+    std::vector<Keyframe>().swap(keys_);
+    delete file_;
+    file_ = file;
+    return true;
+}
+
+bool KeyframeTrack::mapped() const {
+    return file_ != 0;
+}
+
+int KeyframeTrack::Insert(const Keyframe &keyframe) {
+    unmap();
+    std::vector<Keyframe>::iterator position =
+        std::upper_bound(keys_.begin(), keys_.end(), keyframe, earlier);
+    int index = position - keys_.begin();
+    keys_.insert(position, keyframe);
+    renumber(index, last());
+    return index;
+}
+
+int KeyframeTrack::Set(int index, const Keyframe &keyframe) {
+    assert(index >= 0 && index < size());
+    unmap();
+    keys_[index] = keyframe;
+
+    // Move the keyframe to where Insert would have put it, shifting the
+    // keyframes in between by one.
+    std::vector<Keyframe>::iterator current = keys_.begin() + index;
+    std::vector<Keyframe>::iterator position;
+    if (index > 0 && earlier(keyframe, keys_[index - 1])) {
+        position = std::upper_bound(keys_.begin(), current, keyframe, earlier);
+        std::rotate(position, current, current + 1);
+    } else {
+        position = std::upper_bound(current + 1, keys_.end(), keyframe,
+                                    earlier) - 1;
+        std::rotate(current, current + 1, position + 1);
+    }
+
+    int moved = position - keys_.begin();
+    renumber(std::min(index, moved), std::max(index, moved));
+    return moved;
+}
+
+void KeyframeTrack::Reserve(int count) {
+    unmap();
+    keys_.reserve(count);
+}
+
+void KeyframeTrack::Append(const Keyframe &keyframe) {
+    unmap();
+    keys_.push_back(keyframe);
+    keys_.back().setID(last());
+}
+
+void KeyframeTrack::Sort() {
+    // Mapped files are sorted, or they would not have been mapped.
+    if (file_ || std::is_sorted(keys_.begin(), keys_.end(), earlier))
+        return;
+    std::stable_sort(keys_.begin(), keys_.end(), earlier);
+    renumber(0, last());
+}
+
+void KeyframeTrack::Clear() {
+    keys_.clear();
+    delete file_;
+    file_ = 0;
+}
+
+void KeyframeTrack::Swap(KeyframeTrack &other) {
+    keys_.swap(other.keys_);
+    std::swap(file_, other.file_);
+}
+
+Keyframe::Pose KeyframeTrack::Sample(float time,
+                                     PlaybackCursor *cursor) const {
+    if (size() == 0)
+        return Keyframe().getDOFVector();
+    return interpolateKeyframes(view(), time, cursor);
+}
+
+void KeyframeTrack::Sample(const float *times, int count, float *poses,
+                           PlaybackCursor *cursor) const {
+    if (size() == 0) {
+        for (int i = 0; i < count; i++) {
+            memcpy(poses + i * Keyframe::NUM_JOINT_ENUM,
+                   Keyframe().getDOFVector().getData(),
+                   Keyframe::NUM_JOINT_ENUM * sizeof(float));
+        }
+        return;
+    }
+    interpolateKeyframes(view(), times, count, poses, cursor);
+}
+
+void KeyframeTrack::unmap() {
+    if (!file_)
+        return;
+
+    int count = file_->size();
+    keys_.resize(count);
+    for (int i = 0; i < count; i++)
+        keys_[i] = (*this)[i];
+    delete file_;
+    file_ = 0;
+}
+
+void KeyframeTrack::renumber(int from, int to) {
+    for (int i = from; i <= to; i++)
+        keys_[i].setID(i);
+}
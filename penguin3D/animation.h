@@ -0,0 +1,199 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include <stddef.h>
+#include <vector>
+#include "keyframe.h"
+
+// A TrackView is where the times and poses of a track of keyframes are
+// stored: an array of Keyframes, or the packed arrays of a keyframe file (see
+// keyframefile.h) used in place. The keyframes have non-decreasing times and
+// poses of @Keyframe::NUM_JOINT_ENUM@ values, or of some of them for the
+// channels of a ChannelTrack (see channeltrack.h). Get the view of a
+// KeyframeTrack (see below) with @track.view()@.
+class TrackView {
+    public:
+        // The keyframes @keys[0]@ to @keys[last]@.
+        TrackView(const Keyframe *keys, int last);
+
+        // @last + 1@ packed times and, one after the other, as many poses.
+        TrackView(const float *times, const float *poses, int last);
+
+        // @last + 1@ times and poses, each time @timeStride@ bytes and each
+        // pose @poseStride@ bytes after the one before, e.g. in an array of
+        // structs.
+        TrackView(const float *times, ptrdiff_t timeStride,
+                  const float *poses, ptrdiff_t poseStride, int last);
+
+        int last() const { return last_; }
+
+        float time(int i) const {
+            return *reinterpret_cast<const float *>(times_ + i * timeStride_);
+        }
+
+        const float *pose(int i) const {
+            return reinterpret_cast<const float *>(poses_ + i * poseStride_);
+        }
+
+    private:
+        // Strides are in bytes, and big enough not to overflow on tracks of
+        // millions of keyframes.
+        const char *times_;
+        const char *poses_;
+        ptrdiff_t timeStride_;
+        ptrdiff_t poseStride_;
+        int last_;
+};
+
+// Returns the index @i@ of the first keyframe of the track whose time is not
+// less than @time@, so that @track.time(i - 1) < time <= track.time(i)@ when
+// both exist. Returns @track.last() + 1@ if every keyframe is earlier.
+//
+// This is a binary search, O(log n) in the length of the track.
+int findKeyframe(const TrackView &track, float time);
+
+// A PlaybackCursor finds keyframes like findKeyframe but remembers the last
+// result. Since playback mostly moves forward by less than a segment per
+// frame, the next lookup is usually the same or the following keyframe and
+// takes O(1); anything else falls back to the binary search.
+//
+// Use one cursor per playback, e.g. per animated character.
+class PlaybackCursor {
+    public:
+        PlaybackCursor();
+
+        // Same as findKeyframe.
+        int Find(const TrackView &track, float time);
+
+        // Forgets the last result.
+        void Reset();
+
+    private:
+        int index_;
+};
+
+struct SplineSegment; // Forward declaration.
+
+// Returns segment @i@ of the track, from keyframe @i - 1@ to keyframe @i@,
+// for 0 < i <= track.last(). This is the segment interpolateKeyframes
+// samples between those keyframes.
+SplineSegment keyframeSegment(const TrackView &track, int i);
+
+// Returns the cubic Hermite interpolation at @t@ in [0, 1] between @p0@ and
+// @p1@ with tangents @t0@ and @t1@. With Catmull-Rom tangents this is the
+// segment of a Catmull-Rom spline between @p0@ and @p1@.
+//
+// @V@ can be any vector type with addition and multiplication by a float,
+// e.g. Keyframe::Pose or Vector. For a FixedVector, @a2@ and @a3@ are
+// expressions rather than vectors (see fixedvector.h), so the whole
+// polynomial is evaluated in one pass over the values.
+template <typename V>
+V catmullRom(const V &p0, const V &p1, const V &t0, const V &t1, float t) {
+    auto a2 = p0 * (-3) + p1 * 3 + t0 * (-2) + t1 * (-1);
+    auto a3 = p0 * 2 + p1 * (-2) + t0 + t1;
+    return ((a3 * t + a2) * t + t0) * t + p0;
+}
+
+// Returns the pose of the track at the given time using Catmull-Rom
+// interpolation of the keyframes. The track needs at least one keyframe.
+//
+// Keyframes are looked up with @cursor@ if one is given, and with findKeyframe
+// otherwise; both give the same result. The DOFs are interpolated with SIMD
+// instructions where the CPU has them (see spline.h). Nothing is allocated.
+Keyframe::Pose interpolateKeyframes(const TrackView &track, float time,
+                                    PlaybackCursor *cursor = 0);
+
+// Writes the poses of the track at @count@ times to @poses@, one pose of
+// @Keyframe::NUM_JOINT_ENUM@ values after the other. The times can be in any
+// order, but a cursor only helps if they mostly increase, e.g. consecutive
+// frames.
+void interpolateKeyframes(const TrackView &track, const float *times,
+                          int count, float *poses, PlaybackCursor *cursor = 0);
+
+class KeyframeFile; // Forward declaration.
+
+// A KeyframeTrack is a growable track of keyframes, kept sorted by time.
+// Keyframe IDs are kept equal to their indices in the track.
+//
+// Appending keyframes in time order takes amortized O(1), so tracks of
+// millions of keyframes can be built or loaded in linear time.
+//
+// A track can also be read from a mapped keyframe file (see keyframefile.h),
+// which is sampled in place. It is only copied into the track the first time
+// the track is changed.
+class KeyframeTrack {
+    public:
+        KeyframeTrack();
+        ~KeyframeTrack();
+
+        // Number of keyframes.
+        int size() const;
+
+        // Index of the last keyframe, or -1 if the track is empty.
+        int last() const;
+
+        // Time of the last keyframe, or 0 if the track is empty.
+        float duration() const;
+
+        // Where the keyframes are, for the functions above.
+        TrackView view() const;
+
+        // A copy of the keyframe at the given index.
+        Keyframe operator[](int index) const;
+
+        // Makes the track use the keyframes of the given keyframe file in
+        // place. Returns false, leaving the track unchanged, if the file
+        // cannot be mapped.
+        bool Map(const char *filename);
+
+        // True if the track uses a mapped file.
+        bool mapped() const;
+
+        // Inserts a copy of the given keyframe after every keyframe with the
+        // same or an earlier time and returns its index.
+        int Insert(const Keyframe &keyframe);
+
+        // Replaces the keyframe at the given index, moving it to keep the track
+        // sorted if its time changed, and returns its new index.
+        int Set(int index, const Keyframe &keyframe);
+
+        // Makes room for the given number of keyframes, so that appending
+        // that many does not reallocate.
+        void Reserve(int count);
+
+        // Appends a copy of the given keyframe without keeping the track
+        // sorted, for building a track in bulk. Call @Sort@ when done.
+        void Append(const Keyframe &keyframe);
+
+        // Sorts the keyframes by time, keeping the order of keyframes with
+        // equal times. Takes O(n) if they are sorted already.
+        void Sort();
+
+        // Removes all keyframes.
+        void Clear();
+
+        // Exchanges the keyframes (and files) of two tracks.
+        void Swap(KeyframeTrack &other);
+
+        // Same as interpolateKeyframes on the track. An empty track gives the
+        // default pose.
+        Keyframe::Pose Sample(float time, PlaybackCursor *cursor = 0) const;
+        void Sample(const float *times, int count, float *poses,
+                    PlaybackCursor *cursor = 0) const;
+
+    private:
+        KeyframeTrack(const KeyframeTrack &);
+        KeyframeTrack &operator =(const KeyframeTrack &);
+
+        // Copies the keyframes of the mapped file, if any, into the track
+        // and unmaps it, so that they can be changed.
+        void unmap();
+
+        // Makes the IDs of the keyframes from @from@ to @to@ their indices.
+        void renumber(int from, int to);
+
+        std::vector<Keyframe> keys_;
+        KeyframeFile *file_;
+};
+
+#endif /* end of include guard: ANIMATION_H */
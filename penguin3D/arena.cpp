@@ -0,0 +1,60 @@
+#include "arena.h"
+#include <stdlib.h>
+
+Arena *Arena::current_ = 0;
+
+Arena::Arena() {
+    blocks_ = 0;
+    next_ = end_ = 0;
+    destructors_ = 0;
+    objects_ = used_ = reserved_ = 0;
+}
+
+Arena::~Arena() {
+    Clear();
+}
+
+void Arena::Clear() {
+    // Destructors may still look at other objects of the arena, so no memory
+    // is freed until all of them have run.
+    while (destructors_ != 0) {
+        Destructor *destructor = destructors_;
+        destructors_ = destructor->next;
+        destructor->destroy(destructor->object);
+    }
+
+    while (blocks_ != 0) {
+        Block *block = blocks_;
+        blocks_ = block->next;
+        free(block);
+    }
+
+    next_ = end_ = 0;
+    objects_ = used_ = reserved_ = 0;
+}
+
+void *Arena::Allocate(size_t size, size_t align) {
+    size_t padding = -reinterpret_cast<size_t>(next_) & (align - 1);
+
+    if (next_ == 0 || padding + size > static_cast<size_t>(end_ - next_)) {
+        // Room is left for aligning the first object after the header.
+        size_t capacity = (size > BLOCK_SIZE ? size : BLOCK_SIZE) + align;
+        Block *block = static_cast<Block*>(malloc(sizeof(Block) + capacity));
+        if (block == 0)
+            throw std::bad_alloc();
+
+        block->next = blocks_;
+        block->size = capacity;
+        blocks_ = block;
+        reserved_ += sizeof(Block) + capacity;
+
+        next_ = reinterpret_cast<char*>(block + 1);
+        end_ = next_ + capacity;
+        padding = -reinterpret_cast<size_t>(next_) & (align - 1);
+    }
+
+    void *memory = next_ + padding;
+    next_ += padding + size;
+    used_ += padding + size;
+    return memory;
+}
@@ -0,0 +1,168 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+class Arena; // Forward declaration.
+
+// Base of objects that may be allocated in an Arena, i.e. Components and
+// Suppliers.
+//
+// An object that owns another one frees it with @release@ rather than
+// @delete@, which leaves objects allocated in an arena to that arena.
+class ArenaObject {
+    public:
+        ArenaObject() : arena_(0) {}
+        ArenaObject(const ArenaObject &) : arena_(0) {}
+        ArenaObject &operator =(const ArenaObject &) { return *this; }
+
+        // The arena this object was allocated in, or null if it was
+        // allocated on the heap.
+        Arena *arena() const { return arena_; }
+
+    private:
+        friend class Arena;
+        Arena *arena_;
+};
+
+// Deletes the given object unless it belongs to an arena.
+template <typename T>
+void release(T *object) {
+    if (object != 0 && object->arena() == 0)
+        delete object;
+}
+
+// An Arena allocates objects by bumping a pointer through large blocks and
+// destroys all of them at once.
+//
+// A rig allocates every Component and Supplier in one arena. Its nodes end up
+// next to each other in memory in the order they were created, which is
+// roughly the order they are traversed in, and the whole rig can be freed
+// with a single call to @Clear@ regardless of who references whom.
+//
+// Objects outside the arena must not be left holding objects of the arena
+// when it is cleared; in particular, a container that owns arena objects
+// should be in the arena itself.
+//
+// Use an ArenaScope to make the Component and Supplier factories allocate
+// from an arena.
+class Arena {
+    public:
+        // Size of the blocks memory is reserved in. Larger objects get a
+        // block of their own.
+        static const size_t BLOCK_SIZE = 16 * 1024;
+
+        Arena();
+        ~Arena();
+
+        // Constructs a T in the arena. It is destroyed by @Clear@, in reverse
+        // order of construction.
+        template <typename T, typename... Args>
+        T *New(Args&&... args);
+
+        // Destroys all objects and frees all memory of the arena.
+        void Clear();
+
+        // Number of objects constructed in the arena.
+        size_t Objects() const { return objects_; }
+
+        // Number of bytes used by objects, including alignment padding.
+        size_t Used() const { return used_; }
+
+        // Number of bytes reserved from the system.
+        size_t Reserved() const { return reserved_; }
+
+        // The arena factories currently allocate from, or null if they use
+        // the heap.
+        static Arena *current() { return current_; }
+
+        // Constructs a T in the current arena, or on the heap if there is
+        // none.
+        template <typename T, typename... Args>
+        static T *create(Args&&... args);
+
+    private:
+        friend class ArenaScope;
+
+        // Header of a block. The memory of the block follows it.
+        struct Block {
+            Block *next;
+            size_t size;
+        };
+
+        // Record of an object that has to be destroyed by @Clear@.
+        struct Destructor {
+            void (*destroy)(void *object);
+            void *object;
+            Destructor *next;
+        };
+
+        // Returns @size@ bytes aligned to @align@.
+        void *Allocate(size_t size, size_t align);
+
+        template <typename T>
+        static void destroy(void *object) { static_cast<T*>(object)->~T(); }
+
+        static void adopt(ArenaObject *object, Arena *arena) {
+            object->arena_ = arena;
+        }
+        static void adopt(void *, Arena *) {}
+
+        Arena(const Arena &);
+        Arena &operator =(const Arena &);
+
+        Block *blocks_;
+        char *next_;
+        char *end_;
+        Destructor *destructors_;
+
+        size_t objects_;
+        size_t used_;
+        size_t reserved_;
+
+        static Arena *current_;
+};
+
+// Makes the Component and Supplier factories allocate from the given arena for
+// as long as the scope lives.
+class ArenaScope {
+    public:
+        ArenaScope(Arena &arena) : previous_(Arena::current_) {
+            Arena::current_ = &arena;
+        }
+        ~ArenaScope() { Arena::current_ = previous_; }
+
+    private:
+        Arena *previous_;
+};
+
+template <typename T, typename... Args>
+T *Arena::New(Args&&... args) {
+    void *memory = Allocate(sizeof(T), alignof(T));
+    T *object = new (memory) T(std::forward<Args>(args)...);
+
+    if (!std::is_trivially_destructible<T>::value) {
+        Destructor *destructor = static_cast<Destructor*>(
+                Allocate(sizeof(Destructor), alignof(Destructor)));
+        destructor->destroy = &Arena::destroy<T>;
+        destructor->object = object;
+        destructor->next = destructors_;
+        destructors_ = destructor;
+    }
+
+    adopt(object, this);
+    objects_++;
+    return object;
+}
+
+template <typename T, typename... Args>
+T *Arena::create(Args&&... args) {
+    if (current_ != 0)
+        return current_->New<T>(std::forward<Args>(args)...);
+    return new T(std::forward<Args>(args)...);
+}
+
+#endif /* end of include guard: ARENA_H */
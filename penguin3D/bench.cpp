@@ -0,0 +1,841 @@
+#include "penguin.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "channeltrack.h"
+#include "keyframefile.h"
+#include "posetable.h"
+#include "spline.h"
+#include "timer.h"
+#include "triplebuffer.h"
+#include "vector.h"
+
+// The benchmarks of the penguin, a program of their own that runs without a
+// window. Each option runs one benchmark (see BENCHMARKS below), e.g.
+//
+//    penguin_bench --rig --deep-rig
+//
+// runs two of them, in order. The program fails if any benchmark finds its
+// results wrong.
+
+// Crowd benchmark (see the --crowd option): crowds of 1, 10 and so on up to
+// CROWD_BENCHMARK_MAX penguins are updated.
+const int CROWD_BENCHMARK_MAX = 10000;
+
+// Playback benchmark (see the --playback option): a synthetic track of
+// PLAYBACK_BENCHMARK_KEYS keyframes, PLAYBACK_BENCHMARK_KEY_SEC seconds apart,
+// is sampled at 60 Hz from start to end. The linear scan is only timed for
+// PLAYBACK_BENCHMARK_SCANS samples spread over the track.
+const int PLAYBACK_BENCHMARK_KEYS = 1000000;
+const float PLAYBACK_BENCHMARK_KEY_SEC = 1.0 / 30.0;
+const int PLAYBACK_BENCHMARK_SCANS = 200;
+
+// Load benchmark (see the --load option): a synthetic track of
+// LOAD_BENCHMARK_KEYS keyframes is saved as a text list and as a keyframe
+// file, loaded back from both, and the files are removed. The text list is
+// also saved and loaded the old way, with stdio.
+const int LOAD_BENCHMARK_KEYS = 1000000;
+const char *const LOAD_BENCHMARK_TEXT = "benchmark_keyframes.txt";
+const char *const LOAD_BENCHMARK_BINARY = "benchmark_keyframes.pkf";
+
+// Channel benchmark (see the --channels option): a synthetic track of
+// CHANNEL_BENCHMARK_KEYS keyframes, in which each keyframe changes one of
+// CHANNEL_BENCHMARK_ANIMATED DOFs, is sampled at 60 Hz as keyframes and as
+// channels.
+const int CHANNEL_BENCHMARK_KEYS = 100000;
+const int CHANNEL_BENCHMARK_ANIMATED = 6;
+
+// Bake benchmark (see the --bake option): the playback benchmark track,
+// cut to BAKE_BENCHMARK_KEYS keyframes, is baked at BAKE_RATE and sampled at
+// 60 Hz from the channels and from the baked poses.
+const int BAKE_BENCHMARK_KEYS = 10000;
+
+// Pose benchmark (see the --pose option): number of Catmull-Rom samples
+// interpolated with each pose type.
+const int POSE_BENCHMARK_SAMPLES = 1000000;
+
+// Rig benchmark (see the --rig option): the penguin and a synthetic rig
+// of RIG_BENCHMARK_NODES joints, each with up to RIG_BENCHMARK_CHILDREN
+// children, are compiled and drawn as trees and as command buffers.
+const int RIG_BENCHMARK_NODES = 10000;
+const int RIG_BENCHMARK_CHILDREN = 4;
+
+// Deep rig benchmark (see the --deep-rig option): a chain of
+// DEEP_RIG_BENCHMARK_NODES joints is drawn while all of its DOFs, only that
+// of the first joint, only that of the last joint, or none of them change.
+const int DEEP_RIG_BENCHMARK_NODES = 1000;
+
+// Handoff stress test (see the --handoff option): a writer thread
+// publishes HANDOFF_STRESS_UPDATES updates, each with the poses of a crowd of
+// HANDOFF_STRESS_CROWD members, while the main thread takes them and checks
+// that every value it reads belongs to the same update.
+const int HANDOFF_STRESS_UPDATES = 200000;
+const int HANDOFF_STRESS_CROWD = 100;
+
+// Times crowd updates, i.e. the poses and matrices of every member, for
+// crowds of up to CROWD_BENCHMARK_MAX penguins and prints the frame times.
+// Nothing is drawn, so no window (or OpenGL context) is needed.
+static int benchmarkCrowd() {
+    KeyframeTextError error;
+    if (!loadKeyframes(filenameKF, &error)) {
+        formatLoadError(msg, filenameKF, error);
+        printf("%s\n", msg);
+        return 1;
+    }
+
+    buildPenguin();
+    CommandBuffer commands;
+    compilePipeline(commands, &PENGUIN);
+    Crowd crowd(commands, Keyframe::NUM_JOINT_ENUM, interpolatePoses,
+                keyframes.duration());
+
+    Matrix view = Matrix::identity();
+    view.translate(camXPos, camYPos, camZPos);
+
+    printf("%10s %12s %12s\n", "penguins", "ms/frame", "us/penguin");
+    for (int count = 1; count <= CROWD_BENCHMARK_MAX; count *= 10) {
+        crowd.Populate(count, CROWD_SPACING);
+
+        // Run for at least half a second to get a stable average.
+        Timer timer;
+        int frames = 0;
+        do {
+            crowd.Update(frames * SEC_PER_FRAME, view);
+            frames++;
+        } while (timer.elapsed() < 0.5 || frames < 3);
+
+        double ms = timer.elapsed() * 1000 / frames;
+        printf("%10d %12.3f %12.3f\n", count, ms, ms * 1000 / count);
+    }
+    return 0;
+}
+
+
+// Returns the index of the keyframe the old linear scan finds for the given
+// time, for comparison in benchmarkPlayback().
+static int findKeyframeLinear(const TrackView &track, float time) {
+    int i = 0;
+    while ( i <= track.last() && track.time(i) < time )
+        i++;
+    return i;
+}
+
+// Fills the given empty track with @count@ synthetic keyframes,
+// PLAYBACK_BENCHMARK_KEY_SEC seconds apart.
+static void buildBenchmarkTrack(KeyframeTrack &track, int count) {
+    Keyframe keyframe;
+    for (int i = 0; i < count; i++) {
+        keyframe.setTime(i * PLAYBACK_BENCHMARK_KEY_SEC);
+        for (int dof = 0; dof < Keyframe::NUM_JOINT_ENUM; dof++)
+            keyframe.setDOF(dof, 30 * sinf(i * 0.1f + dof));
+        track.Append(keyframe);
+    }
+}
+
+// Times keyframe lookups on a synthetic track of PLAYBACK_BENCHMARK_KEYS
+// keyframes sampled at 60 Hz with the linear scan, findKeyframe and a
+// PlaybackCursor, and full samples (lookup and interpolation) with the cursor.
+// Lookups that disagree with findKeyframe are counted and reported.
+static int benchmarkPlayback() {
+    KeyframeTrack track;
+    buildBenchmarkTrack(track, PLAYBACK_BENCHMARK_KEYS);
+
+    TrackView keys = track.view();
+    int samples = int(track.duration() / SEC_PER_FRAME) + 1;
+    int scanStep = samples / PLAYBACK_BENCHMARK_SCANS;
+    int mismatches = 0;
+    double checksum = 0;
+
+    printf("%d keyframes, %d samples at 60 Hz\n", PLAYBACK_BENCHMARK_KEYS,
+           samples);
+    printf("%-22s %10s %12s\n", "method", "samples", "us/sample");
+
+    Timer timer;
+    for (int s = 0; s < samples; s += scanStep) {
+        float time = s * SEC_PER_FRAME;
+        int i = findKeyframeLinear(keys, time);
+        mismatches += i != findKeyframe(keys, time);
+    }
+    printf("%-22s %10d %12.4f\n", "linear scan", PLAYBACK_BENCHMARK_SCANS,
+           timer.elapsed() * 1e6 / PLAYBACK_BENCHMARK_SCANS);
+
+    timer.reset();
+    for (int s = 0; s < samples; s++)
+        checksum += findKeyframe(keys, s * SEC_PER_FRAME);
+    printf("%-22s %10d %12.4f\n", "binary search", samples,
+           timer.elapsed() * 1e6 / samples);
+
+    PlaybackCursor cursor;
+    timer.reset();
+    for (int s = 0; s < samples; s++)
+        checksum -= cursor.Find(keys, s * SEC_PER_FRAME);
+    printf("%-22s %10d %12.4f\n", "cursor", samples,
+           timer.elapsed() * 1e6 / samples);
+    if (checksum != 0)
+        mismatches++;
+
+    cursor.Reset();
+    timer.reset();
+    for (int s = 0; s < samples; s++)
+        checksum += interpolateKeyframes(keys, s * SEC_PER_FRAME, &cursor)[0];
+    printf("%-22s %10d %12.4f\n", "cursor + interpolation", samples,
+           timer.elapsed() * 1e6 / samples);
+
+    if (mismatches > 0) {
+        printf("%d lookup(s) disagree with findKeyframe\n", mismatches);
+        return 1;
+    }
+    return 0;
+}
+
+// Times sampling a synthetic track of CHANNEL_BENCHMARK_KEYS keyframes at 60 Hz
+// as keyframes and as channels, both with cursors, and prints the memory each
+// takes. Each keyframe changes one of CHANNEL_BENCHMARK_ANIMATED DOFs, starting
+// at HEAD_PITCH, and keeps the others. Poses sampled from the channels that
+// differ from those sampled from the keyframes are counted and reported.
+static int benchmarkChannels() {
+    KeyframeTrack track;
+    Keyframe keyframe;
+    for (int i = 0; i < CHANNEL_BENCHMARK_KEYS; i++) {
+        keyframe.setTime(i * PLAYBACK_BENCHMARK_KEY_SEC);
+        keyframe.setDOF(Keyframe::HEAD_PITCH + i % CHANNEL_BENCHMARK_ANIMATED,
+                        30 * sinf(i * 0.1f));
+        track.Append(keyframe);
+    }
+
+    Timer timer;
+    ChannelTrack channels;
+    channels.Build(track.view());
+    double buildMs = timer.elapsed() * 1000;
+
+    int animated = 0;
+    for (int dof = 0; dof < Keyframe::NUM_JOINT_ENUM; dof++)
+        animated += !channels.constant(dof);
+    printf("%d keyframes, %d animated DOFs, channels built in %.1f ms\n",
+           CHANNEL_BENCHMARK_KEYS, animated, buildMs);
+
+    int samples = int(track.duration() / SEC_PER_FRAME) + 1;
+    std::vector<float> times(samples);
+    for (int s = 0; s < samples; s++)
+        times[s] = s * SEC_PER_FRAME;
+    std::vector<float> keyframePoses(samples * Keyframe::NUM_JOINT_ENUM);
+    std::vector<float> channelPoses(samples * Keyframe::NUM_JOINT_ENUM);
+
+    PlaybackCursor keyframeCursor;
+    timer.reset();
+    track.Sample(&times[0], samples, &keyframePoses[0], &keyframeCursor);
+    double keyframeUs = timer.elapsed() * 1e6;
+
+    ChannelCursor channelCursor;
+    timer.reset();
+    channels.Sample(&times[0], samples, &channelPoses[0], &channelCursor);
+    double channelUs = timer.elapsed() * 1e6;
+
+    int mismatches = 0;
+    for (int s = 0; s < samples; s++) {
+        int pose = s * Keyframe::NUM_JOINT_ENUM;
+        mismatches += memcmp(&keyframePoses[pose], &channelPoses[pose],
+                             Keyframe::NUM_JOINT_ENUM * sizeof(float)) != 0;
+    }
+
+    printf("%-10s %12s %12s %12s\n", "storage", "values", "KB", "us/sample");
+    printf("%-10s %12d %12.1f %12.4f\n", "keyframes",
+           track.size() * Keyframe::NUM_JOINT_ENUM,
+           track.size() * sizeof(Keyframe) / 1024.0,
+           keyframeUs / samples);
+    printf("%-10s %12d %12.1f %12.4f\n", "channels", channels.keyCount(),
+           channels.bytes() / 1024.0, channelUs / samples);
+
+    if (mismatches > 0) {
+        printf("%d sample(s) differ\n", mismatches);
+        return 1;
+    }
+    return 0;
+}
+
+// Returns the largest difference between the @count@ values at @a@ and @b@.
+static float largestDifference(const float *a, const float *b, size_t count) {
+    float largest = 0;
+    for (size_t i = 0; i < count; i++)
+        if (fabsf(a[i] - b[i]) > largest)
+            largest = fabsf(a[i] - b[i]);
+    return largest;
+}
+
+// Bakes BAKE_BENCHMARK_KEYS keyframes of the playback benchmark track at
+// BAKE_RATE, as floats and quantized, and times sampling them at 60 Hz
+// against sampling the channels. Prints the size of each and their largest
+// difference from the channels.
+static int benchmarkBake() {
+    KeyframeTrack track;
+    buildBenchmarkTrack(track, BAKE_BENCHMARK_KEYS);
+    ChannelTrack channels;
+    channels.Build(track.view());
+
+    int samples = int(channels.duration() / SEC_PER_FRAME) + 1;
+    std::vector<float> times(samples);
+    for (int s = 0; s < samples; s++)
+        times[s] = s * SEC_PER_FRAME;
+    const int dofs = Keyframe::NUM_JOINT_ENUM;
+    std::vector<float> expected(samples * dofs), poses(samples * dofs);
+
+    printf("%d keyframes baked at %g Hz, %d samples at 60 Hz\n",
+           BAKE_BENCHMARK_KEYS, BAKE_RATE, samples);
+    printf("%-14s %10s %10s %12s %12s\n", "source", "KB", "bake ms",
+           "us/sample", "max error");
+
+    ChannelCursor cursor;
+    Timer timer;
+    channels.Sample(&times[0], samples, &expected[0], &cursor);
+    printf("%-14s %10.1f %10s %12.4f %12g\n", "channels",
+           channels.bytes() / 1024.0, "", timer.elapsed() * 1e6 / samples, 0.0);
+
+    for (int quantize = 0; quantize <= 1; quantize++) {
+        PoseTable table;
+        timer.reset();
+        table.Bake(channels, BAKE_RATE, quantize);
+        double bakeMs = timer.elapsed() * 1000;
+
+        timer.reset();
+        table.Sample(&times[0], samples, &poses[0]);
+        double us = timer.elapsed() * 1e6 / samples;
+        printf("%-14s %10.1f %10.1f %12.4f %12g\n",
+               quantize ? "baked 16-bit" : "baked floats",
+               table.bytes() / 1024.0, bakeMs, us,
+               largestDifference(&expected[0], &poses[0], expected.size()));
+    }
+    return 0;
+}
+
+
+// Returns the Catmull-Rom interpolation at @t@ between @points[1]@ and
+// @points[2]@, computed the same way for any pose type.
+template <typename V>
+static V sampleSegment(const V *points, float t) {
+    V t0 = (points[2] - points[0]) * 0.5;
+    V t1 = (points[3] - points[1]) * 0.5;
+    return catmullRom(points[1], points[2], t0, t1, t);
+}
+
+// Times POSE_BENCHMARK_SAMPLES Catmull-Rom samples of the same four poses
+// stored in heap-backed Vectors and in inline Keyframe::Poses, and with the
+// spline kernel for every instruction set the CPU supports. Checks that the
+// Vector and Pose samples are the same, and that the kernel samples are within
+// 1e-5 of them.
+static int benchmarkPose() {
+    const int dofs = Keyframe::NUM_JOINT_ENUM;
+    Vector vectors[4] = { Vector(dofs), Vector(dofs), Vector(dofs), Vector(dofs) };
+    Keyframe::Pose poses[4];
+    for (int i = 0; i < 4; i++) {
+        for (int dof = 0; dof < dofs; dof++) {
+            vectors[i][dof] = 30 * sinf(i + dof * 0.5f);
+            poses[i][dof] = vectors[i][dof];
+        }
+    }
+
+    Vector vectorSum(dofs);
+    Keyframe::Pose poseSum;
+    printf("%-16s %10s %12s\n", "pose type", "samples", "ns/sample");
+
+    Timer timer;
+    for (int s = 0; s < POSE_BENCHMARK_SAMPLES; s++)
+        vectorSum += sampleSegment(vectors, float(s) / POSE_BENCHMARK_SAMPLES);
+    printf("%-16s %10d %12.2f\n", "Vector", POSE_BENCHMARK_SAMPLES,
+           timer.elapsed() * 1e9 / POSE_BENCHMARK_SAMPLES);
+
+    timer.reset();
+    for (int s = 0; s < POSE_BENCHMARK_SAMPLES; s++)
+        poseSum += sampleSegment(poses, float(s) / POSE_BENCHMARK_SAMPLES);
+    printf("%-16s %10d %12.2f\n", "Keyframe::Pose", POSE_BENCHMARK_SAMPLES,
+           timer.elapsed() * 1e9 / POSE_BENCHMARK_SAMPLES);
+
+    if (memcmp(vectorSum.getData(), poseSum.getData(), sizeof(float) * dofs)) {
+        printf("Vector and Keyframe::Pose samples differ\n");
+        return 1;
+    }
+
+    SplineSegment segment;
+    segment.prev = poses[0].getData();
+    segment.p0 = poses[1].getData();
+    segment.p1 = poses[2].getData();
+    segment.next = poses[3].getData();
+    segment.s0 = 0.5;
+    segment.s1 = 0.5;
+
+    SimdLevel selected = simdLevel();
+    float error = 0;
+    for (int level = SIMD_SCALAR; level <= supportedSimdLevel(); level++) {
+        selectSimdLevel(SimdLevel(level));
+
+        Keyframe::Pose sample;
+        timer.reset();
+        for (int s = 0; s < POSE_BENCHMARK_SAMPLES; s++) {
+            evaluateSpline(segment, float(s) / POSE_BENCHMARK_SAMPLES, dofs,
+                           sample.getData());
+        }
+        double ns = timer.elapsed() * 1e9 / POSE_BENCHMARK_SAMPLES;
+        printf("%-16s %10d %12.2f\n", simdLevelName(SimdLevel(level)),
+               POSE_BENCHMARK_SAMPLES, ns);
+
+        // Compare a few samples with the Pose ones.
+        for (int s = 0; s < POSE_BENCHMARK_SAMPLES; s += 997) {
+            float t = float(s) / POSE_BENCHMARK_SAMPLES;
+            Keyframe::Pose expected = sampleSegment(poses, t);
+            evaluateSpline(segment, t, dofs, sample.getData());
+            for (int dof = 0; dof < dofs; dof++)
+                error = fmaxf(error, fabsf(sample[dof] - expected[dof]));
+        }
+    }
+    selectSimdLevel(selected);
+
+    printf("largest difference from Keyframe::Pose: %g\n", error);
+    if (error > 1e-5) {
+        printf("spline kernel samples differ\n");
+        return 1;
+    }
+    return 0;
+}
+
+
+// Returns the size of the given file in megabytes, or 0 if it cannot be read.
+static double fileMegabytes(const char *filename) {
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL)
+        return 0;
+    fseek(file, 0, SEEK_END);
+    double size = ftell(file) / (1024.0 * 1024.0);
+    fclose(file);
+    return size;
+}
+
+// Returns the number of keyframes of @keyframes@ whose time or DOFs differ
+// from those of @expected@.
+static int countMismatches(const KeyframeTrack &expected) {
+    if (keyframes.size() != expected.size())
+        return expected.size();
+
+    TrackView have = keyframes.view(), want = expected.view();
+    int mismatches = 0;
+    for (int i = 0; i < expected.size(); i++) {
+        mismatches += have.time(i) != want.time(i) ||
+                      memcmp(have.pose(i), want.pose(i),
+                             Keyframe::NUM_JOINT_ENUM * sizeof(float)) != 0;
+    }
+    return mismatches;
+}
+
+// Reads a text keyframe list into the given empty track the way the old
+// reader did, one fscanf per value, for comparison in benchmarkLoad().
+static bool readKeyframeListScanf(const char *filename, KeyframeTrack &track)
+{
+    // Open file for reading
+    FILE* file = fopen(filename, "r");
+    if ( file == NULL )
+        return false;
+
+    // Read in the index of the last keyframe first (-1 for none)
+    int last;
+    bool ok = fscanf(file, "%d", &last) == 1 && last >= -1;
+
+    // Now read in all keyframes in the format:
+    //    id
+    //    time
+    //    DOFs
+    //
+    // The keyframes are only counted by the index read above, so the track
+    // grows as they are read and a wrong index cannot overrun anything.
+    Keyframe keyframe;
+    for ( int i = 0; ok && i <= last; i++ ) {
+        ok = fscanf(file, "%d", keyframe.getIDPtr()) == 1 &&
+             fscanf(file, "%f", keyframe.getTimePtr()) == 1;
+
+        for ( int j = 0; ok && j < Keyframe::NUM_JOINT_ENUM; j++ )
+            ok = fscanf(file, "%f", keyframe.getDOFPtr(j)) == 1;
+
+        if ( ok )
+            track.Append(keyframe);
+    }
+
+    // Close file
+    fclose(file);
+    if ( ok )
+        track.Sort();
+    return ok;
+}
+
+// Writes the given track as a text list the way the old writer did, one
+// fprintf per value with printf's six decimals, for comparison in
+// benchmarkLoad(). Returns false if the file cannot be written.
+static bool writeKeyframeListPrintf(const char *filename, const TrackView &track)
+{
+    // Open file for writing
+    FILE* file = fopen(filename, "w");
+    if ( file == NULL )
+        return false;
+
+    // Write out the index of the last keyframe first
+    fprintf(file, "%d\n", track.last());
+    fprintf(file, "\n");
+
+    // Now write out all keyframes in the format:
+    //    id
+    //    time
+    //    DOFs
+    //
+    for ( int i = 0; i <= track.last(); i++ ) {
+        fprintf(file, "%d\n", i);
+        fprintf(file, "%f\n", track.time(i));
+
+        for ( int j = 0; j < Keyframe::NUM_JOINT_ENUM; j++ )
+            fprintf(file, "%f\n", track.pose(i)[j]);
+
+        fprintf(file, "\n");
+    }
+
+    // Close file
+    return fclose(file) == 0;
+}
+
+// Saves a synthetic track of LOAD_BENCHMARK_KEYS keyframes as a text list and
+// as a keyframe file, and times saving and loading each of them, as well as
+// saving the text list with the old fprintf writer and loading it with the
+// old fscanf reader. Checks that every load gives back the track exactly;
+// the fprintf list only keeps six decimals, so it is not loaded.
+static int benchmarkLoad() {
+    KeyframeTrack track;
+    buildBenchmarkTrack(track, LOAD_BENCHMARK_KEYS);
+    printf("%d keyframes\n", LOAD_BENCHMARK_KEYS);
+    printf("%-14s %10s %12s %12s\n", "format", "MB", "save ms", "load ms");
+
+    Timer timer;
+    bool saved = writeKeyframeListPrintf(LOAD_BENCHMARK_TEXT, track.view());
+    double printfSave = timer.elapsed() * 1000;
+    printf("%-14s %10.1f %12.1f %12s\n", "text (fprintf)",
+           fileMegabytes(LOAD_BENCHMARK_TEXT), printfSave, "");
+    timer.reset();
+    saved = saved && writeKeyframeText(LOAD_BENCHMARK_TEXT, track.view());
+    double textSave = timer.elapsed() * 1000;
+    timer.reset();
+    saved = saved && writeKeyframeFile(LOAD_BENCHMARK_BINARY, track.view());
+    double binarySave = timer.elapsed() * 1000;
+    if (!saved) {
+        printf("Failed to write the benchmark files\n");
+        remove(LOAD_BENCHMARK_TEXT);
+        remove(LOAD_BENCHMARK_BINARY);
+        return 1;
+    }
+
+    // Write the files back now, or the system does it while they load.
+    sync();
+
+    KeyframeTrack scanned;
+    timer.reset();
+    bool loaded = readKeyframeListScanf(LOAD_BENCHMARK_TEXT, scanned);
+    double scanfLoad = timer.elapsed() * 1000;
+    printf("%-14s %10.1f %12s %12.1f\n", "text (fscanf)",
+           fileMegabytes(LOAD_BENCHMARK_TEXT), "", scanfLoad);
+    keyframes.Swap(scanned);
+    keyframesChanged();
+    int mismatches = loaded ? countMismatches(track) : track.size();
+
+    // Like the fscanf reader, the loads below start from no keyframes, so
+    // that freeing the keyframes they replace is not timed with them.
+    scanned.Swap(keyframes);
+    keyframesChanged();
+    timer.reset();
+    loaded = loadKeyframes(LOAD_BENCHMARK_TEXT);
+    double textLoad = timer.elapsed() * 1000;
+    printf("%-14s %10.1f %12.1f %12.1f\n", "text",
+           fileMegabytes(LOAD_BENCHMARK_TEXT), textSave, textLoad);
+    mismatches += loaded ? countMismatches(track) : track.size();
+
+    KeyframeTrack text;
+    text.Swap(keyframes);
+    keyframesChanged();
+    timer.reset();
+    loaded = loadKeyframes(LOAD_BENCHMARK_BINARY);
+    printf("%-14s %10.1f %12.1f %12.1f\n", "keyframe file",
+           fileMegabytes(LOAD_BENCHMARK_BINARY), binarySave,
+           timer.elapsed() * 1000);
+    mismatches += loaded ? countMismatches(track) : track.size();
+
+    printf("text saves %.1fx as fast as fprintf, loads %.1fx as fast as fscanf\n",
+           printfSave / textSave, scanfLoad / textLoad);
+
+    keyframes.Clear();
+    keyframesChanged();
+    remove(LOAD_BENCHMARK_TEXT);
+    remove(LOAD_BENCHMARK_BINARY);
+    if (mismatches > 0) {
+        printf("%d loaded keyframe(s) differ\n", mismatches);
+        return 1;
+    }
+    return 0;
+}
+
+// Returns true if every value of the given update is its time, as written by
+// stressHandoff().
+static bool wholeUpdate(const AnimationUpdate &update) {
+    float value = float(update.time);
+    for (int dof = 0; dof < Keyframe::NUM_JOINT_ENUM; dof++)
+        if (update.previous[dof] != value || update.current[dof] != value)
+            return false;
+    for (size_t i = 0; i < update.crowdTimes.size(); i++)
+        if (update.crowdTimes[i] != value)
+            return false;
+    for (size_t i = 0; i < update.crowdPoses.size(); i++)
+        if (update.crowdPoses[i] != value)
+            return false;
+    return update.poseTime == value;
+}
+
+// Publishes HANDOFF_STRESS_UPDATES animation updates from a writer thread as
+// fast as it can, every value of update @n@ set to @n@, while this thread
+// takes them as fast as it can. Counts the updates taken that mix values of
+// different updates (torn) or come before one taken earlier, and reports them.
+static int stressHandoff() {
+    TripleBuffer<AnimationUpdate> updates;
+    std::atomic<bool> done(false);
+    std::thread writer([&updates, &done] {
+        for (int n = 1; n <= HANDOFF_STRESS_UPDATES; n++) {
+            AnimationUpdate &update = updates.Back();
+            float value = float(n);
+            update.time = n;
+            update.poseTime = value;
+            for (int dof = 0; dof < Keyframe::NUM_JOINT_ENUM; dof++) {
+                update.previous[dof] = value;
+                update.current[dof] = value;
+            }
+            update.crowdTimes.assign(HANDOFF_STRESS_CROWD, value);
+            update.crowdPoses.assign(HANDOFF_STRESS_CROWD *
+                                     Keyframe::NUM_JOINT_ENUM, value);
+            updates.Publish();
+        }
+        done = true;
+    });
+
+    Timer timer;
+    int taken = 0, torn = 0, late = 0;
+    double last = 0;
+    for (;;) {
+        bool finished = done;
+        if (updates.Update()) {
+            const AnimationUpdate &update = updates.Front();
+            taken++;
+            torn += !wholeUpdate(update);
+            late += update.time <= last;
+            last = update.time;
+        } else if (finished) {
+            break;
+        }
+    }
+    writer.join();
+
+    printf("%d updates of %d crowd poses published in %.1f ms\n",
+           HANDOFF_STRESS_UPDATES, HANDOFF_STRESS_CROWD,
+           timer.elapsed() * 1000);
+    printf("%d taken, the last one %s, %d torn, %d out of order\n", taken,
+           last == HANDOFF_STRESS_UPDATES ? "included" : "missing", torn, late);
+    return torn > 0 || late > 0 || last != HANDOFF_STRESS_UPDATES;
+}
+
+
+// Calls @frame@ with the frame number for at least half a second, to get a
+// stable average, and returns its average time in microseconds.
+template <typename F>
+static double microsecondsPerFrame(F frame) {
+    Timer timer;
+    int frames = 0;
+    do {
+        frame(frames);
+        frames++;
+    } while (timer.elapsed() < 0.5 || frames < 3);
+    return timer.elapsed() * 1e6 / frames;
+}
+
+// Builds a synthetic rig of @nodes@ joints in the current arena and returns
+// its root. Joint @i@ is a child of joint @(i - 1) / children@; it is offset
+// from its parent, rotated about X by DOF @i@, and draws a cuboid.
+static Entity *buildBenchmarkRig(int nodes, int children) {
+    std::vector<Entity *> joints(nodes);
+    for (int i = 0; i < nodes; i++) {
+        Entity *joint = Component::entity();
+        joint->AddComponent(Component::translate(0, 1, 0));
+        joint->AddComponent(Component::rotatable(Binding::dof(i)));
+        joint->AddComponent(Component::cuboid(0.2, 1, 0.2));
+        if (i > 0)
+            joints[(i - 1) / children]->AddComponent(joint);
+        joints[i] = joint;
+    }
+    return joints[0];
+}
+
+// Times compiling the given rig, and drawing it from the tree and from the
+// compiled buffer for a pose of @dofs@ DOFs that all change every frame, and
+// prints them as a row of benchmarkRig().
+static void benchmarkRigRow(const char *name, Component *root, float *pose,
+                            int dofs) {
+    Matrix view = Matrix::identity();
+    view.translate(camXPos, camYPos, camZPos);
+
+    CommandBuffer commands;
+    double compileUs = microsecondsPerFrame([&](int) {
+        compilePipeline(commands, root);
+    });
+    double treeUs = microsecondsPerFrame([&](int frame) {
+        for (int dof = 0; dof < dofs; dof++)
+            pose[dof] = frame + dof;
+        glLoadMatrixf(view.m);
+        root->Update(pose);
+    });
+    double bufferUs = microsecondsPerFrame([&](int frame) {
+        for (int dof = 0; dof < dofs; dof++)
+            pose[dof] = frame + dof;
+        commands.Execute(view, pose);
+    });
+    printf("%-22s %10d %12.3f %12.2f %12.2f\n", name, commands.size(),
+           compileUs / 1000, treeUs, bufferUs);
+}
+
+// Times compiling the penguin and a synthetic rig of RIG_BENCHMARK_NODES
+// joints into command buffers, and drawing them from the component tree and
+// from the buffer. No window is opened: without a current context OpenGL
+// calls do nothing, so the times are those of walking the tree and of
+// executing the buffer.
+static int benchmarkRig() {
+    buildPenguin();
+
+    Arena arena;
+    Entity *synthetic;
+    {
+        ArenaScope scope(arena);
+        synthetic = buildBenchmarkRig(RIG_BENCHMARK_NODES,
+                                      RIG_BENCHMARK_CHILDREN);
+    }
+    std::vector<float> pose(RIG_BENCHMARK_NODES);
+
+    printf("%-22s %10s %12s %12s %12s\n", "rig", "commands", "compile ms",
+           "tree us", "buffer us");
+    benchmarkRigRow("penguin", &PENGUIN, STATE.getDOFPtr(0),
+                    Keyframe::NUM_JOINT_ENUM);
+    benchmarkRigRow("synthetic", synthetic, &pose[0], RIG_BENCHMARK_NODES);
+    return 0;
+}
+
+// Times drawing a chain of DEEP_RIG_BENCHMARK_NODES joints from the tree and
+// from a compiled buffer, changing the DOFs of the joints in @first@ to
+// @last@ every frame. The buffer only recomputes the matrices of the joints
+// from @first@ down, so the less of the chain is below the first joint that
+// changes, the less a frame takes.
+static void benchmarkDeepRigRow(const char *name, Component *root,
+                                CommandBuffer &commands, float *pose,
+                                int first, int last) {
+    Matrix view = Matrix::identity();
+    view.translate(camXPos, camYPos, camZPos);
+
+    double treeUs = microsecondsPerFrame([&](int frame) {
+        for (int dof = first; dof <= last; dof++)
+            pose[dof] = frame + dof;
+        glLoadMatrixf(view.m);
+        root->Update(pose);
+    });
+    double bufferUs = microsecondsPerFrame([&](int frame) {
+        for (int dof = first; dof <= last; dof++)
+            pose[dof] = frame + dof;
+        commands.Execute(view, pose);
+    });
+    printf("%-22s %12.2f %12.2f %12.2f\n", name, treeUs, bufferUs,
+           treeUs / bufferUs);
+}
+
+// Times drawing a chain of DEEP_RIG_BENCHMARK_NODES joints, each rotated by
+// a DOF of its own, as all DOFs, a single DOF or none change between frames.
+// Without a window, like benchmarkRig().
+static int benchmarkDeepRig() {
+    Arena arena;
+    Entity *chain;
+    {
+        ArenaScope scope(arena);
+        chain = buildBenchmarkRig(DEEP_RIG_BENCHMARK_NODES, 1);
+    }
+    std::vector<float> pose(DEEP_RIG_BENCHMARK_NODES);
+    CommandBuffer commands;
+    compilePipeline(commands, chain);
+
+    const int last = DEEP_RIG_BENCHMARK_NODES - 1;
+    printf("%d joints, %d commands\n", DEEP_RIG_BENCHMARK_NODES,
+           commands.size());
+    printf("%-22s %12s %12s %12s\n", "DOFs changed", "tree us", "buffer us",
+           "speedup");
+    benchmarkDeepRigRow("all", chain, commands, &pose[0], 0, last);
+    benchmarkDeepRigRow("first joint", chain, commands, &pose[0], 0, 0);
+    benchmarkDeepRigRow("last joint", chain, commands, &pose[0], last, last);
+    benchmarkDeepRigRow("none", chain, commands, &pose[0], 0, -1);
+    return 0;
+}
+
+// A benchmark and the option that runs it.
+struct Benchmark {
+    const char *option;
+    int (*run)();
+    const char *description;
+};
+
+const Benchmark BENCHMARKS[] = {
+    { "--crowd", benchmarkCrowd,
+      "times crowd updates of up to CROWD_BENCHMARK_MAX penguins" },
+    { "--rig", benchmarkRig,
+      "times compiling and drawing the penguin and a synthetic rig" },
+    { "--deep-rig", benchmarkDeepRig,
+      "times drawing a chain of joints as one DOF changes" },
+    { "--playback", benchmarkPlayback,
+      "times keyframe lookups on a track of 1M keyframes" },
+    { "--channels", benchmarkChannels,
+      "times sampling sparse keyframes as keyframes and as channels" },
+    { "--bake", benchmarkBake,
+      "times sampling keyframes from channels and baked poses" },
+    { "--pose", benchmarkPose,
+      "times interpolating poses stored in Vector and Keyframe::Pose" },
+    { "--load", benchmarkLoad,
+      "times saving and loading 1M keyframes as text and keyframe files" },
+    { "--handoff", stressHandoff,
+      "checks that animation updates handed between threads are never torn" },
+};
+const int BENCHMARK_COUNT = sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]);
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        printf("Usage: penguin_bench OPTION...\n");
+        for (int b = 0; b < BENCHMARK_COUNT; b++)
+            printf("    %-12s %s\n", BENCHMARKS[b].option,
+                   BENCHMARKS[b].description);
+        return 1;
+    }
+
+    // Check every option before running anything, since some of the
+    // benchmarks take a while.
+    for (int i = 1; i < argc; i++) {
+        int b = 0;
+        while (b < BENCHMARK_COUNT && strcmp(argv[i], BENCHMARKS[b].option) != 0)
+            b++;
+        if (b == BENCHMARK_COUNT) {
+            printf("Unknown benchmark %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    int failed = 0;
+    for (int i = 1; i < argc; i++) {
+        for (int b = 0; b < BENCHMARK_COUNT; b++)
+            if (strcmp(argv[i], BENCHMARKS[b].option) == 0)
+                failed |= BENCHMARKS[b].run();
+    }
+    return failed;
+}
@@ -0,0 +1,230 @@
+#include "channeltrack.h"
+#include "spline.h"
+#include <string.h>
+#include <assert.h>
+
+void ChannelCursor::Reset() {
+    packed_.Reset();
+    for (int c = 0; c < Keyframe::NUM_JOINT_ENUM; c++)
+        channels_[c].Reset();
+}
+
+// Returns true if @a@ and @b@ are the same float, bit for bit, so that
+// channels holding them are sampled exactly the same.
+static bool sameValue(float a, float b) {
+    return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+// Returns true if the spline of the given channel is flat on both sides of
+// keyframe @k@, so that the keyframe is not needed: the segments on both
+// sides depend on keyframes k - 2 to k + 2, which must all have the same
+// value. The first and last keyframes are always needed.
+static bool inFlatRun(const TrackView &track, int channel, int k) {
+    int last = track.last();
+    if (k == 0 || k == last)
+        return false;
+
+    float value = track.pose(k)[channel];
+    int from = k - 2 > 0 ? k - 2 : 0;
+    int to = k + 2 < last ? k + 2 : last;
+    for (int i = from; i <= to; i++) {
+        if (!sameValue(track.pose(i)[channel], value))
+            return false;
+    }
+    return true;
+}
+
+ChannelTrack::ChannelTrack()
+    : constants_(), packed_(), packedTimes_(), packedValues_(), sparse_(),
+      keys_() {
+    Clear();
+}
+
+void ChannelTrack::Build(const TrackView &track) {
+    const int dofs = Keyframe::NUM_JOINT_ENUM;
+    Clear();
+    int last = track.last();
+    if (last < 0)
+        return;
+
+    last_ = last;
+    duration_ = track.time(last);
+    memcpy(constants_.getData(), track.pose(0), dofs * sizeof(float));
+
+    // Go through the keyframes in order rather than a channel at a time,
+    // since every pass over a long track reads all of it, and gather the
+    // keys of each channel separately.
+    bool constant[dofs];
+    for (int c = 0; c < dofs; c++)
+        constant[c] = true;
+    for (int i = 1; i <= last; i++) {
+        const float *pose = track.pose(i);
+        for (int c = 0; c < dofs; c++)
+            constant[c] = constant[c] && sameValue(pose[c], constants_[c]);
+    }
+
+    std::vector<std::vector<Key> > channels(dofs);
+    for (int i = 0; i <= last; i++) {
+        for (int c = 0; c < dofs; c++) {
+            if (constant[c] || inFlatRun(track, c, i))
+                continue;
+            Key key = { track.time(i), track.pose(i)[c], i };
+            channels[c].push_back(key);
+        }
+    }
+
+    // A key takes three floats, so a channel that keeps more than a third of
+    // the keyframes takes less memory packed.
+    size_t count = 0;
+    for (int c = 0; c < dofs; c++) {
+        if (constant[c])
+            continue;
+        if (3 * channels[c].size() > size_t(last + 1)) {
+            packed_.push_back(c);
+        } else {
+            sparse_.push_back(c);
+            count += channels[c].size();
+        }
+    }
+
+    if (!packed_.empty()) {
+        packedTimes_.resize(last + 1);
+        packedValues_.resize((last + 1) * packed_.size());
+        for (int i = 0; i <= last; i++) {
+            packedTimes_[i] = track.time(i);
+            for (size_t p = 0; p < packed_.size(); p++)
+                packedValues_[i * packed_.size() + p] = track.pose(i)[packed_[p]];
+        }
+    }
+
+    keys_.reserve(count);
+    for (int c = 0; c < dofs; c++) {
+        first_[c] = keys_.size();
+        if (!packed(c))
+            keys_.insert(keys_.end(), channels[c].begin(), channels[c].end());
+    }
+    first_[dofs] = keys_.size();
+}
+
+void ChannelTrack::Clear() {
+    last_ = -1;
+    duration_ = 0;
+    constants_ = Keyframe().getDOFVector();
+    packed_.clear();
+    packedTimes_.clear();
+    packedValues_.clear();
+    sparse_.clear();
+    for (int c = 0; c <= Keyframe::NUM_JOINT_ENUM; c++)
+        first_[c] = 0;
+    keys_.clear();
+}
+
+int ChannelTrack::size() const {
+    return last_ + 1;
+}
+
+float ChannelTrack::duration() const {
+    return duration_;
+}
+
+bool ChannelTrack::constant(int channel) const {
+    return keyCount(channel) == 0;
+}
+
+bool ChannelTrack::packed(int channel) const {
+    for (size_t p = 0; p < packed_.size(); p++) {
+        if (packed_[p] == channel)
+            return true;
+    }
+    return false;
+}
+
+int ChannelTrack::keyCount(int channel) const {
+    if (packed(channel))
+        return size();
+    return first_[channel + 1] - first_[channel];
+}
+
+int ChannelTrack::keyCount() const {
+    return keys_.size() + packedValues_.size();
+}
+
+size_t ChannelTrack::bytes() const {
+    return keys_.size() * sizeof(Key) +
+           (packedTimes_.size() + packedValues_.size()) * sizeof(float) +
+           sizeof(constants_);
+}
+
+TrackView ChannelTrack::packedView() const {
+    return TrackView(&packedTimes_[0], sizeof(float), &packedValues_[0],
+                     packed_.size() * sizeof(float), last_);
+}
+
+TrackView ChannelTrack::channel(int channel) const {
+    assert(!constant(channel) && !packed(channel));
+    const Key *keys = &keys_[first_[channel]];
+    return TrackView(&keys->time, sizeof(Key), &keys->value, sizeof(Key),
+                     keyCount(channel) - 1);
+}
+
+void ChannelTrack::samplePose(float time, ChannelCursor *cursor,
+                              float *pose) const {
+    const int dofs = Keyframe::NUM_JOINT_ENUM;
+    memcpy(pose, constants_.getData(), dofs * sizeof(float));
+
+    // The packed channels are sampled like the keyframes they come from.
+    if (!packed_.empty()) {
+        TrackView track = packedView();
+        int i = cursor ? cursor->packed_.Find(track, time)
+                       : findKeyframe(track, time);
+
+        float values[dofs];
+        const float *sampled = values;
+        if (i == 0) {
+            sampled = track.pose(0);
+        } else if (i > last_) {
+            sampled = track.pose(last_);
+        } else {
+            float t = (time - track.time(i - 1)) / (track.time(i) - track.time(i - 1));
+            evaluateSpline(keyframeSegment(track, i), t, packed_.size(), values);
+        }
+        for (size_t p = 0; p < packed_.size(); p++)
+            pose[packed_[p]] = sampled[p];
+    }
+
+    for (size_t s = 0; s < sparse_.size(); s++) {
+        int c = sparse_[s];
+        TrackView track = channel(c);
+        const Key *keys = &keys_[first_[c]];
+        int last = track.last();
+        int i = cursor ? cursor->channels_[c].Find(track, time)
+                       : findKeyframe(track, time);
+
+        // Before the first and after the last key, and between the keys
+        // around a run of equal values, the channel holds its value.
+        // Otherwise the keys are neighbouring keyframes, as are the keys
+        // around them if their values matter (see inFlatRun).
+        if (i == 0) {
+            pose[c] = keys[0].value;
+        } else if (i > last) {
+            pose[c] = keys[last].value;
+        } else if (keys[i].index - keys[i - 1].index > 1) {
+            pose[c] = keys[i - 1].value;
+        } else {
+            float t = (time - keys[i - 1].time) / (keys[i].time - keys[i - 1].time);
+            pose[c] = evaluateAt(keyframeSegment(track, i), t, 0);
+        }
+    }
+}
+
+Keyframe::Pose ChannelTrack::Sample(float time, ChannelCursor *cursor) const {
+    Keyframe::Pose pose;
+    samplePose(time, cursor, pose.getData());
+    return pose;
+}
+
+void ChannelTrack::Sample(const float *times, int count, float *poses,
+                          ChannelCursor *cursor) const {
+    for (int i = 0; i < count; i++)
+        samplePose(times[i], cursor, poses + i * Keyframe::NUM_JOINT_ENUM);
+}
@@ -0,0 +1,122 @@
+#ifndef CHANNELTRACK_H
+#define CHANNELTRACK_H
+
+#include <stddef.h>
+#include <vector>
+#include "animation.h"
+
+// Where playback is in the channels of a ChannelTrack: a PlaybackCursor (see
+// animation.h) for the packed channels and one for every other channel.
+class ChannelCursor {
+    public:
+        // Forgets the last result of every channel.
+        void Reset();
+
+    private:
+        friend class ChannelTrack;
+        PlaybackCursor packed_;
+        PlaybackCursor channels_[Keyframe::NUM_JOINT_ENUM];
+};
+
+// A ChannelTrack stores a track of keyframes one DOF channel at a time, each
+// channel with its own keys, so that values that do not change are not stored
+// over and over:
+//
+//  - A channel with the same value in every keyframe is constant. Its value is
+//    stored once, and sampling just copies it.
+//  - Other channels keep a key only where the spline is not flat on both
+//    sides of it, i.e. not in the middle of five or more equal values. The
+//    channel holds its value between the keys around such a run.
+//  - Channels that would keep more than a third of the keys are packed
+//    instead: their values in every keyframe are stored together, next to
+//    the times of the keyframes, and sampled together with one lookup and
+//    the spline kernel (see spline.h). Below a third, a channel of its own
+//    takes less memory, and above it, less time too.
+//
+// Every other segment is the one interpolateKeyframes samples for the
+// channel, so the poses are exactly the same as those of the track the
+// channels were built from. Memory and sampling time grow with the number of
+// keys the channels keep, not with the number of keyframes times
+// NUM_JOINT_ENUM. A ChannelTrack does not change with the track it was built
+// from; build it again after editing the track.
+class ChannelTrack {
+    public:
+        // A key of a channel: its time and value in the keyframe it comes
+        // from, and the index of that keyframe.
+        struct Key {
+            float time;
+            float value;
+            int index;
+        };
+
+        ChannelTrack();
+
+        // Replaces the channels with those of the given track.
+        void Build(const TrackView &track);
+
+        // Removes all channels, as if built from an empty track.
+        void Clear();
+
+        // Number of keyframes of the track the channels were built from.
+        int size() const;
+
+        // Time of the last keyframe, or 0 if the track is empty.
+        float duration() const;
+
+        // True if the given channel has the same value in every keyframe.
+        bool constant(int channel) const;
+
+        // True if the given channel is packed with the others that change
+        // in most keyframes.
+        bool packed(int channel) const;
+
+        // Number of values the given channel keeps: 0 if it is constant, one
+        // per keyframe if it is packed, and one per key otherwise.
+        int keyCount(int channel) const;
+
+        // Number of values all channels keep.
+        int keyCount() const;
+
+        // Bytes taken by the keys, packed values and times, and constant
+        // values.
+        size_t bytes() const;
+
+        // Same as interpolateKeyframes on the track the channels were built
+        // from, with a cursor per channel if one is given. An empty track
+        // gives the default pose.
+        Keyframe::Pose Sample(float time, ChannelCursor *cursor = 0) const;
+        void Sample(const float *times, int count, float *poses,
+                    ChannelCursor *cursor = 0) const;
+
+    private:
+        ChannelTrack(const ChannelTrack &);
+        ChannelTrack &operator =(const ChannelTrack &);
+
+        // The keyframes of the packed channels, and the keys of the given
+        // channel, which must be neither constant nor packed.
+        TrackView packedView() const;
+        TrackView channel(int channel) const;
+
+        // Writes the pose at the given time to @pose@.
+        void samplePose(float time, ChannelCursor *cursor, float *pose) const;
+
+        int last_;
+        float duration_;
+
+        // Value of every constant channel, and the first value of the others.
+        Keyframe::Pose constants_;
+
+        // Packed channels, with the time of every keyframe and, one keyframe
+        // after the other, their values in it.
+        std::vector<int> packed_;
+        std::vector<float> packedTimes_;
+        std::vector<float> packedValues_;
+
+        // Channels with keys of their own. The keys of channel @c@ are
+        // @keys_[first_[c]]@ up to @keys_[first_[c + 1]]@, excluded.
+        std::vector<int> sparse_;
+        int first_[Keyframe::NUM_JOINT_ENUM + 1];
+        std::vector<Key> keys_;
+};
+
+#endif /* end of include guard: CHANNELTRACK_H */
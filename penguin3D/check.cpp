@@ -0,0 +1,156 @@
+#include "penguin.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <new>
+
+// The checks of the penguin, a program of their own so that the penguin
+// keeps the global operator new and delete of the standard library. They
+// draw without a window, and are run with:
+//
+//    penguin_check [--allocations] [--teardown]
+//
+// which runs the given checks, or all of them, and fails if any does.
+
+// Allocation check (see the --allocations option): number of frames
+// drawn, each in a different pose, after the first one.
+const int ALLOCATION_CHECK_FRAMES = 1000;
+
+// Teardown check (see the --teardown option): number of times the
+// penguin and its render pipelines are built, drawn and destroyed.
+const int TEARDOWN_CHECK_CYCLES = 100;
+
+// Number of calls of the global operator new so far, for checkAllocations(),
+// and number of the memory blocks it returned that are not deleted yet, for
+// checkTeardown(). Replacing the global operators only adds the counts, so
+// the rest of the program is unaffected; the penguin itself is built without
+// them.
+static std::atomic<long> allocationCount(0);
+static std::atomic<long> liveAllocations(0);
+
+void *operator new(size_t size) {
+    allocationCount++;
+    void *memory = malloc(size > 0 ? size : 1);
+    if (memory == 0)
+        throw std::bad_alloc();
+    liveAllocations++;
+    return memory;
+}
+
+void operator delete(void *memory) noexcept {
+    if (memory != 0)
+        liveAllocations--;
+    free(memory);
+}
+
+// Draws ALLOCATION_CHECK_FRAMES frames of the penguin like display() does,
+// each in a different pose, and counts the allocations they make. The first
+// frame, which builds the render pipeline, is not counted. Returns 1 if any
+// frame allocated.
+//
+// No window is opened: without a current context OpenGL calls do nothing,
+// and the commands that make them are executed all the same.
+static int checkAllocations() {
+    buildPenguin();
+
+    Matrix view = Matrix::identity();
+    view.translate(camXPos, camYPos, camZPos);
+    currentPipeline().Execute(view, STATE.getDOFPtr(0));
+
+    long before = allocationCount;
+    for (int frame = 0; frame < ALLOCATION_CHECK_FRAMES; frame++) {
+        for (int dof = 0; dof < Keyframe::NUM_JOINT_ENUM; dof++)
+            STATE.setDOF(dof, 30 * sinf(0.1f * frame + dof));
+        light_angle = frame;
+        light_pos[0] = LIGHT_CIRCLE_RADIUS * cosf(deg2rad(light_angle));
+        light_pos[1] = LIGHT_CIRCLE_RADIUS * sinf(deg2rad(light_angle));
+        currentPipeline().Execute(view, STATE.getDOFPtr(0));
+    }
+    long allocations = allocationCount - before;
+
+    printf("%d frames drawn, %ld allocations\n", ALLOCATION_CHECK_FRAMES,
+           allocations);
+    return allocations > 0;
+}
+
+// Builds the penguin in an arena of its own, and a pipeline for it with every
+// combination of render settings, draws each of them once, and destroys them
+// all, TEARDOWN_CHECK_CYCLES times. Returns 1 if the cycles leave any memory
+// from operator new behind. Memory from elsewhere is only checked by a leak
+// checker, e.g. when built with -fsanitize=address.
+//
+// No window is opened, like checkAllocations().
+static int checkTeardown() {
+    Matrix view = Matrix::identity();
+    view.translate(camXPos, camYPos, camZPos);
+
+    // Whatever the first cycle allocates for good, e.g. on the first call of
+    // a library function, is not counted.
+    long before = 0;
+    int built = 0;
+    size_t objects = 0, used = 0, reserved = 0;
+    for (int cycle = 0; cycle <= TEARDOWN_CHECK_CYCLES; cycle++) {
+        if (cycle == 1)
+            before = liveAllocations;
+
+        Arena rig;
+        Entity &penguin = *rig.New<Entity>();
+        {
+            ArenaScope scope(rig);
+            buildPenguin(penguin);
+        }
+        objects = rig.Objects();
+        used = rig.Used();
+        reserved = rig.Reserved();
+
+        Arena pipelines;
+        CommandBuffer commands;
+        built = 0;
+        for (renderStyle = WIREFRAME; renderStyle <= MATTE; renderStyle++)
+        for (shadeModel = SHADE_FLAT; shadeModel <= SHADE_SMOOTH; shadeModel++)
+        for (coloredMaterials = 0; coloredMaterials <= 1; coloredMaterials++) {
+            Component *root;
+            {
+                ArenaScope scope(pipelines);
+                root = buildPipeline(penguin);
+            }
+            compilePipeline(commands, root);
+            commands.Execute(view, STATE.getDOFPtr(0));
+            built++;
+        }
+    }
+    long left = liveAllocations - before;
+
+    printf("Rig: %d objects, %d bytes used, %d bytes reserved\n",
+           (int)objects, (int)used, (int)reserved);
+    printf("%d cycles of a rig and %d pipelines, %ld allocations left\n",
+           TEARDOWN_CHECK_CYCLES, built, left);
+    return left != 0;
+}
+
+int main(int argc, char** argv)
+{
+    //    --allocations   checks that drawing ALLOCATION_CHECK_FRAMES frames
+    //                    allocates nothing
+    //    --teardown      checks that building and destroying the penguin
+    //                    and its pipelines leaves nothing behind
+    bool allocations = argc < 2, teardown = argc < 2;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--allocations") == 0) {
+            allocations = true;
+        } else if (strcmp(argv[i], "--teardown") == 0) {
+            teardown = true;
+        } else {
+            printf("Usage: penguin_check [--allocations] [--teardown]\n");
+            return 1;
+        }
+    }
+
+    int failed = 0;
+    if (allocations)
+        failed |= checkAllocations();
+    if (teardown)
+        failed |= checkTeardown();
+    return failed;
+}
@@ -0,0 +1,625 @@
+#include "command.h"
+#include "component.h"
+#include "gl.h"
+#include <assert.h>
+#include <string.h>
+
+//////////////////////////////////////////////////////////////////////////////
+// CommandBuffer
+//////////////////////////////////////////////////////////////////////////////
+
+CommandBuffer::CommandBuffer()
+    : commands_(), caches_(), geometry_(), ends_(1, 0), depth_(0),
+      transforms_(), taken_(), stack_(), changed_(1) {
+    view_ = Matrix::identity();
+    frame_ = 1;
+}
+
+void CommandBuffer::Compile(Component *component) {
+    commands_.clear();
+    caches_.clear();
+    geometry_.Clear();
+    component->Compile(*this);
+    measure();
+}
+
+static bool isTransform(Command::Op op) {
+    switch (op) {
+        case Command::TRANSLATE:
+        case Command::ROTATE:
+        case Command::SCALE:
+        case Command::MULTIPLY:
+        case Command::UPDATE_TRANSFORM:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void CommandBuffer::measure() {
+    int count = commands_.size();
+    ends_.assign(count + 1, 0);
+    transforms_.assign(count, 0);
+    taken_.assign(count, 0);
+
+    // Depth of the stack when executing, and when evaluating, which also
+    // pushes a level for every conditional region it is in.
+    int depth = 0, regions = 0;
+    depth_ = 0;
+    for (int i = 0; i < count; i++) {
+        regions -= ends_[i];
+
+        const Command &command = commands_[i];
+        if (command.op == Command::PUSH_MATRIX)
+            depth++;
+        else if (command.op == Command::POP_MATRIX)
+            depth--;
+        else if (command.op == Command::SKIP_UNLESS) {
+            ends_[i + command.branch.count + 1]++;
+            regions++;
+
+            // Look for a transform that is not undone by a pop within the
+            // region, i.e. one at the depth the region starts at.
+            int nested = 0;
+            for (int j = i + 1; j <= i + command.branch.count; j++) {
+                Command::Op op = commands_[j].op;
+                if (op == Command::PUSH_MATRIX)
+                    nested++;
+                else if (op == Command::POP_MATRIX)
+                    nested--;
+                else if (nested == 0 && isTransform(op))
+                    transforms_[i] = 1;
+            }
+        }
+
+        if (depth + regions > depth_)
+            depth_ = depth + regions;
+    }
+
+    stack_.Reserve(depth_);
+    if (depth_ + 1 > int(changed_.size()))
+        changed_.resize(depth_ + 1);
+}
+
+int CommandBuffer::Add(const Command &command) {
+    commands_.push_back(command);
+
+    switch (command.op) {
+        case Command::TRANSLATE:
+        case Command::ROTATE:
+        case Command::SCALE:
+        case Command::MULTIPLY:
+            commands_.back().transform.cache = caches_.size();
+            caches_.push_back(TransformCache());
+            caches_.back().valid = false;
+            caches_.back().frame = 0;
+            break;
+        default:
+            break;
+    }
+
+    return commands_.size() - 1;
+}
+
+void CommandBuffer::AddOp(Command::Op op) {
+    Command command;
+    command.op = op;
+    Add(command);
+}
+
+void CommandBuffer::AddUpdate(Component *component, bool transforms) {
+    Command command;
+    command.op = transforms ? Command::UPDATE_TRANSFORM : Command::UPDATE;
+    command.component = component;
+    Add(command);
+}
+
+Geometry &CommandBuffer::geometry() {
+    return geometry_;
+}
+
+Command &CommandBuffer::operator[](int index) {
+    return commands_[index];
+}
+
+int CommandBuffer::size() const {
+    return commands_.size();
+}
+
+// Computes the local matrix of a TRANSLATE, ROTATE or SCALE command for the
+// given operands.
+static void computeLocal(const Command &command, const float input[3],
+                         Matrix &local) {
+    const Command::Transform &transform = command.transform;
+
+    local = Matrix::identity();
+    switch (command.op) {
+        case Command::TRANSLATE:
+            local.translate(input[0], input[1], input[2]);
+            break;
+        case Command::ROTATE:
+            if (transform.source[2].kind() != Binding::NONE)
+                local.rotateZ(input[2]);
+            if (transform.source[0].kind() != Binding::NONE)
+                local.rotateX(input[0]);
+            if (transform.source[1].kind() != Binding::NONE)
+                local.rotateY(input[1]);
+            break;
+        case Command::SCALE:
+            local.scale(input[0], input[1], input[2]);
+            break;
+        default:
+            break;
+    }
+}
+
+// Applies the transform command for the given pose to @cache@ and @stack@
+// during execution number @frame@. @changed@ tells whether the top of the
+// stack differs from the last execution; returns whether the resulting matrix
+// does.
+static bool applyTransform(const Command &command, const float *pose,
+                           TransformCache &cache, unsigned frame,
+                           MatrixStack &stack, bool changed) {
+    const Command::Transform &transform = command.transform;
+    float input[3];
+    for (int i = 0; i < 3; i++)
+        input[i] = transform.source[i].Get(pose);
+
+    bool stale = command.op != Command::MULTIPLY && (!cache.valid ||
+        input[0] != cache.input[0] ||
+        input[1] != cache.input[1] ||
+        input[2] != cache.input[2]);
+
+    // The cached world matrix can only be reused if it was produced by the
+    // last execution; the command may have been skipped since.
+    bool reached = cache.frame == frame - 1;
+    cache.frame = frame;
+
+    if (!stale && !changed && reached) {
+        stack.Top() = cache.world;
+        return false;
+    }
+
+    if (stale) {
+        computeLocal(command, input, cache.local);
+        memcpy(cache.input, input, sizeof input);
+        cache.valid = true;
+    }
+
+    cache.world = Matrix::multiply(stack.Top(), cache.local);
+    stack.Top() = cache.world;
+    return true;
+}
+
+// Applies the transform command for the given pose directly to @top@.
+// @cache@ is only read, for the matrix of a MULTIPLY command.
+static void applyTransform(const Command &command, const float *pose,
+                           const TransformCache &cache, Matrix &top) {
+    const Command::Transform &transform = command.transform;
+    switch (command.op) {
+        case Command::TRANSLATE:
+            top.translate(transform.source[0].Get(pose),
+                          transform.source[1].Get(pose),
+                          transform.source[2].Get(pose));
+            break;
+        case Command::ROTATE:
+            if (transform.source[2].kind() != Binding::NONE)
+                top.rotateZ(transform.source[2].Get(pose));
+            if (transform.source[0].kind() != Binding::NONE)
+                top.rotateX(transform.source[0].Get(pose));
+            if (transform.source[1].kind() != Binding::NONE)
+                top.rotateY(transform.source[1].Get(pose));
+            break;
+        case Command::SCALE:
+            top.scale(transform.source[0].Get(pose),
+                      transform.source[1].Get(pose),
+                      transform.source[2].Get(pose));
+            break;
+        case Command::MULTIPLY:
+            top = Matrix::multiply(top, cache.local);
+            break;
+        default:
+            break;
+    }
+}
+
+int CommandBuffer::Fold(const float *pose, const std::vector<int> &pinned) {
+    int count = commands_.size();
+    std::vector<bool> keep(count, true);
+
+    // Commands that a SKIP_UNLESS may jump to. Nothing is merged across them.
+    std::vector<bool> target(count + 1, false);
+    for (int i = 0; i < count; i++) {
+        if (commands_[i].op == Command::SKIP_UNLESS)
+            target[i + commands_[i].branch.count + 1] = true;
+    }
+
+    // Fold constant transforms. @run@ is the MULTIPLY command that directly
+    // precedes the current command, if any.
+    int run = -1;
+    for (int i = 0; i < count; i++) {
+        Command &command = commands_[i];
+        if (target[i])
+            run = -1;
+
+        if (command.op != Command::TRANSLATE &&
+            command.op != Command::ROTATE &&
+            command.op != Command::SCALE) {
+            run = -1;
+            continue;
+        }
+
+        Command::Transform &transform = command.transform;
+        bool constant = true;
+        float input[3];
+        for (int axis = 0; axis < 3; axis++) {
+            const Binding &source = transform.source[axis];
+            input[axis] = 0;
+            if (source.kind() == Binding::NONE)
+                continue;
+
+            bool fixed = source.IsConstant();
+            for (size_t p = 0; p < pinned.size() && !fixed; p++)
+                fixed = source.kind() == Binding::DOF &&
+                        source.index() == pinned[p];
+
+            if (!fixed) {
+                constant = false;
+                continue;
+            }
+
+            input[axis] = source.Get(pose);
+            if (command.op == Command::ROTATE && input[axis] == 0)
+                transform.source[axis] = Binding();
+        }
+
+        if (!constant) {
+            run = -1;
+            continue;
+        }
+
+        Matrix local;
+        computeLocal(command, input, local);
+        if (memcmp(local.m, Matrix::identity().m, sizeof local.m) == 0) {
+            keep[i] = false;
+            continue;
+        }
+
+        if (run >= 0) {
+            Matrix &merged = caches_[commands_[run].transform.cache].local;
+            merged = Matrix::multiply(merged, local);
+            keep[i] = false;
+            continue;
+        }
+
+        command.op = Command::MULTIPLY;
+        TransformCache &cache = caches_[transform.cache];
+        cache.local = local;
+        cache.valid = true;
+        run = i;
+    }
+
+    // Folded and merged transforms no longer produce the world matrices they
+    // kept, so none of them can be reused.
+    for (size_t i = 0; i < caches_.size(); i++)
+        caches_[i].frame = 0;
+
+    // Remove push/pop pairs that do not enclose a transform of their own.
+    std::vector<int> pushes;
+    std::vector<bool> transforms;
+    for (int i = 0; i < count; i++) {
+        if (!keep[i])
+            continue;
+
+        Command::Op op = commands_[i].op;
+        if (op == Command::PUSH_MATRIX) {
+            pushes.push_back(i);
+            transforms.push_back(false);
+        } else if (op == Command::POP_MATRIX && !pushes.empty()) {
+            if (!transforms.back()) {
+                keep[pushes.back()] = false;
+                keep[i] = false;
+            }
+            pushes.pop_back();
+            transforms.pop_back();
+        } else if (isTransform(op) && !transforms.empty()) {
+            transforms.back() = true;
+        }
+    }
+
+    // Compact the buffer, retargeting the remaining branches.
+    std::vector<int> index(count + 1);
+    int kept = 0;
+    for (int i = 0; i <= count; i++) {
+        index[i] = kept;
+        if (i < count && keep[i])
+            commands_[kept++] = commands_[i];
+    }
+    for (int i = 0; i < count; i++) {
+        if (keep[i] && commands_[index[i]].op == Command::SKIP_UNLESS) {
+            Command::Branch &branch = commands_[index[i]].branch;
+            branch.count = index[i + branch.count + 1] - index[i] - 1;
+        }
+    }
+    commands_.resize(kept);
+    measure();
+
+    return count - kept;
+}
+
+void CommandBuffer::Execute(const float *pose) {
+    Matrix view;
+    glGetFloatv(GL_MODELVIEW_MATRIX, view.m);
+    Execute(view, pose);
+}
+
+void CommandBuffer::Execute(const Matrix &view, const float *pose) {
+    const Command *command = commands_.data();
+    const Command *end = command + commands_.size();
+
+    MatrixStack &stack = stack_;
+    stack.Reset(view);
+
+    // For every level of the stack, whether its matrix differs from the one
+    // at the same point of the last execution.
+    char *changed = &changed_[0];
+    changed[0] = memcmp(view.m, view_.m, sizeof view.m) != 0;
+    view_ = view;
+    frame_++;
+
+    // Whether the top of the stack differs from the matrix loaded in OpenGL.
+    bool dirty = true;
+
+    geometry_.Bind();
+
+    for (; command < end; command++) {
+        switch (command->op) {
+            case Command::PUSH_MATRIX:
+                stack.Push();
+                changed[stack.Depth()] = changed[stack.Depth() - 1];
+                break;
+            case Command::POP_MATRIX:
+                stack.Pop();
+                dirty = true;
+                break;
+            case Command::TRANSLATE:
+            case Command::ROTATE:
+            case Command::SCALE:
+            case Command::MULTIPLY:
+                changed[stack.Depth()] =
+                    applyTransform(*command, pose,
+                                   caches_[command->transform.cache],
+                                   frame_, stack, changed[stack.Depth()]);
+                dirty = true;
+                break;
+            case Command::COLOR:
+                glColor4fv(command->color);
+                break;
+            case Command::DRAW:
+                if (dirty) {
+                    glLoadMatrixf(stack.Top().m);
+                    dirty = false;
+                }
+                geometry_.Draw(command->mesh);
+                break;
+            case Command::ENABLE:
+                glEnable(command->cap);
+                break;
+            case Command::DISABLE:
+                glDisable(command->cap);
+                break;
+            case Command::SKIP_UNLESS: {
+                // A region that transforms at this level and was taken last
+                // time but not now, or the other way around, changes the
+                // matrix after it. When taken, its transforms are not
+                // reached from the last execution, so they make the change
+                // themselves.
+                int index = command - commands_.data();
+                bool taken = *command->branch.condition;
+                if (!taken && taken_[index] && transforms_[index])
+                    changed[stack.Depth()] = true;
+                taken_[index] = taken;
+                if (!taken)
+                    command += command->branch.count;
+                break;
+            }
+            case Command::FUNCTION:
+                if (dirty) {
+                    glLoadMatrixf(stack.Top().m);
+                    dirty = false;
+                }
+                (*command->function)();
+                break;
+            case Command::UPDATE:
+                if (dirty) {
+                    glLoadMatrixf(stack.Top().m);
+                    dirty = false;
+                }
+                command->component->Update(pose);
+                break;
+            case Command::UPDATE_TRANSFORM:
+                if (dirty) {
+                    glLoadMatrixf(stack.Top().m);
+                    dirty = false;
+                }
+                command->component->Update(pose);
+                glGetFloatv(GL_MODELVIEW_MATRIX, stack.Top().m);
+                changed[stack.Depth()] = true;
+                break;
+        }
+    }
+
+    geometry_.Unbind();
+
+    if (dirty)
+        glLoadMatrixf(stack.Top().m);
+}
+
+static bool isDraw(Command::Op op) {
+    switch (op) {
+        case Command::DRAW:
+        case Command::FUNCTION:
+        case Command::UPDATE:
+        case Command::UPDATE_TRANSFORM:
+            return true;
+        default:
+            return false;
+    }
+}
+
+int CommandBuffer::DrawCount() const {
+    int count = 0;
+    for (size_t i = 0; i < commands_.size(); i++) {
+        if (isDraw(commands_[i].op))
+            count++;
+    }
+    return count;
+}
+
+void CommandBuffer::Evaluate(const Matrix &view, const float *pose,
+                             Matrix *matrices, MatrixStack &stack) const {
+    const Command *begin = commands_.data();
+    const Command *end = begin + commands_.size();
+    const int *ends = ends_.data();
+
+    stack.Reserve(depth_);
+    stack.Reset(view);
+
+    // Each conditional region is evaluated on a copy of the matrix, which is
+    // dropped at its end.
+    for (const Command *command = begin; command < end; command++) {
+        for (int i = ends[command - begin]; i > 0; i--)
+            stack.Pop();
+
+        switch (command->op) {
+            case Command::PUSH_MATRIX:
+                stack.Push();
+                break;
+            case Command::POP_MATRIX:
+                stack.Pop();
+                break;
+            case Command::TRANSLATE:
+            case Command::ROTATE:
+            case Command::SCALE:
+            case Command::MULTIPLY:
+                applyTransform(*command, pose,
+                               caches_[command->transform.cache],
+                               stack.Top());
+                break;
+            case Command::SKIP_UNLESS:
+                stack.Push();
+                break;
+            case Command::UPDATE_TRANSFORM:
+                assert(!"UPDATE_TRANSFORM cannot be evaluated");
+                *matrices++ = stack.Top();
+                break;
+            case Command::DRAW:
+            case Command::FUNCTION:
+            case Command::UPDATE:
+                *matrices++ = stack.Top();
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+void CommandBuffer::Replay(const Matrix *matrices, const float *pose) const {
+    const Command *command = commands_.data();
+    const Command *end = command + commands_.size();
+
+    // The matrix currently loaded in OpenGL, if it is one of @matrices@.
+    const Matrix *loaded = 0;
+
+    for (; command < end; command++) {
+        switch (command->op) {
+            case Command::COLOR:
+                glColor4fv(command->color);
+                break;
+            case Command::ENABLE:
+                glEnable(command->cap);
+                break;
+            case Command::DISABLE:
+                glDisable(command->cap);
+                break;
+            case Command::SKIP_UNLESS:
+                if (!*command->branch.condition) {
+                    // Skip the matrices of the skipped commands as well.
+                    const Command *skipped = command + command->branch.count;
+                    while (command < skipped) {
+                        command++;
+                        if (isDraw(command->op))
+                            matrices++;
+                    }
+                }
+                break;
+            case Command::DRAW:
+            case Command::FUNCTION:
+            case Command::UPDATE:
+            case Command::UPDATE_TRANSFORM:
+                if (loaded == 0 ||
+                    memcmp(loaded->m, matrices->m, sizeof loaded->m) != 0)
+                    glLoadMatrixf(matrices->m);
+                loaded = matrices++;
+
+                if (command->op == Command::DRAW)
+                    geometry_.Draw(command->mesh);
+                else if (command->op == Command::FUNCTION)
+                    (*command->function)();
+                else
+                    command->component->Update(pose);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Drawing
+//////////////////////////////////////////////////////////////////////////////
+
+void drawCuboid(const Command::Box &box) {
+    float x1 = box.x1, y1 = box.y1, z1 = box.z1,
+          x2 = box.x2, y2 = box.y2, z2 = box.z2;
+
+    glBegin(box.mode);
+
+    // draw front face
+    glNormal3f(x1, y1, z2); glVertex3f(x1, y1, z2);
+    glNormal3f(x2, y1, z2); glVertex3f(x2, y1, z2);
+    glNormal3f(x2, y2, z2); glVertex3f(x2, y2, z2);
+    glNormal3f(x1, y2, z2); glVertex3f(x1, y2, z2);
+
+    // draw back face
+    glNormal3f(x2, y1, z1); glVertex3f(x2, y1, z1);
+    glNormal3f(x1, y1, z1); glVertex3f(x1, y1, z1);
+    glNormal3f(x1, y2, z1); glVertex3f(x1, y2, z1);
+    glNormal3f(x2, y2, z1); glVertex3f(x2, y2, z1);
+
+    // draw left face
+    glNormal3f(x1, y1, z1); glVertex3f(x1, y1, z1);
+    glNormal3f(x1, y1, z2); glVertex3f(x1, y1, z2);
+    glNormal3f(x1, y2, z2); glVertex3f(x1, y2, z2);
+    glNormal3f(x1, y2, z1); glVertex3f(x1, y2, z1);
+
+    // draw right face
+    glNormal3f(x2, y1, z2); glVertex3f(x2, y1, z2);
+    glNormal3f(x2, y1, z1); glVertex3f(x2, y1, z1);
+    glNormal3f(x2, y2, z1); glVertex3f(x2, y2, z1);
+    glNormal3f(x2, y2, z2); glVertex3f(x2, y2, z2);
+
+    // draw top
+    glNormal3f(x1, y2, z2); glVertex3f(x1, y2, z2);
+    glNormal3f(x2, y2, z2); glVertex3f(x2, y2, z2);
+    glNormal3f(x2, y2, z1); glVertex3f(x2, y2, z1);
+    glNormal3f(x1, y2, z1); glVertex3f(x1, y2, z1);
+
+    // draw bottom
+    glNormal3f(x1, y1, z1); glVertex3f(x1, y1, z1);
+    glNormal3f(x2, y1, z1); glVertex3f(x2, y1, z1);
+    glNormal3f(x2, y1, z2); glVertex3f(x2, y1, z2);
+    glNormal3f(x1, y1, z2); glVertex3f(x1, y1, z2);
+
+    glEnd();
+}
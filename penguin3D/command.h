@@ -0,0 +1,220 @@
+#ifndef COMMAND_H
+#define COMMAND_H
+
+#include <vector>
+#include "component.h"
+#include "geometry.h"
+#include "gl.h"
+#include "matrix.h"
+
+// A Command is a single step of a compiled component tree. Commands are plain
+// values so that a whole rig can be stored in one contiguous array and
+// executed by a tight loop instead of a tree of virtual @Update@ calls.
+//
+// Matrix commands operate on a MatrixStack on the CPU; the resulting matrix
+// is only loaded into OpenGL before a command that may draw.
+struct Command {
+    enum Op {
+        PUSH_MATRIX,    // Pushes the matrix stack.
+        POP_MATRIX,     // Pops the matrix stack.
+        TRANSLATE,      // Translates by the values bound in @transform@.
+        ROTATE,         // Z, X then Y rotations bound in @transform@.
+        SCALE,          // Scales by the values bound in @transform@.
+        MULTIPLY,       // Multiplies by the constant local matrix kept in
+                        // the TransformCache of @transform@.
+        COLOR,          // glColor4fv(@color@)
+        DRAW,           // Draws @mesh@ from the geometry of the buffer.
+        ENABLE,         // glEnable(@cap@)
+        DISABLE,        // glDisable(@cap@)
+        SKIP_UNLESS,    // Skips the next @branch.count@ commands unless
+                        // @*branch.condition@ is true.
+        FUNCTION,       // Calls @function@.
+        UPDATE,         // Falls back to @component->Update(pose)@.
+        UPDATE_TRANSFORM // Same as UPDATE for a component that changes the
+                         // current matrix; the matrix is read back after.
+    };
+
+    struct Box {
+        float x1, y1, z1,
+              x2, y2, z2;
+        GLenum mode;
+    };
+
+    struct Transform {
+        // Bindings of the operands. A NONE binding skips the corresponding
+        // axis of a ROTATE.
+        Binding source[3];
+
+        // Index of the TransformCache of this command. Assigned by
+        // CommandBuffer::Add.
+        int cache;
+    };
+
+    struct Branch {
+        const bool *condition;
+        int count;
+    };
+
+    Op op;
+    union {
+        Transform transform;
+        float color[4];
+        Mesh mesh;
+        GLenum cap;
+        Branch branch;
+        void (*function)();
+        Component *component;
+    };
+};
+
+// The matrices computed by a transform command, along with the operands they
+// were computed from and the execution that last produced @world@. A @frame@
+// of 0 means @world@ was never produced, since executions are numbered from 2.
+struct TransformCache {
+    float input[3];
+    Matrix local;
+    Matrix world;
+    bool valid;
+    unsigned frame;
+};
+
+// A CommandBuffer is a flat array of Commands compiled from a component tree.
+//
+// The tree stays the way rigs are authored; the buffer is only a faster way
+// of executing it. Since commands keep pointers into the tree (bindings are
+// copied but not owned, and unsupported components are called directly), the
+// tree must outlive the buffer.
+class CommandBuffer {
+    public:
+        CommandBuffer();
+
+        // Replaces the contents of the buffer with the commands and geometry
+        // for the given component. Capacity is kept, so recompiling a tree
+        // of the same size does not allocate.
+        void Compile(Component *component);
+
+        // Appends a command to the buffer and returns its index.
+        int Add(const Command &command);
+
+        // Shorthands for @Add@ used by Component::Compile implementations.
+        void AddOp(Command::Op op);
+        void AddUpdate(Component *component, bool transforms = false);
+
+        // The static shapes drawn by DRAW commands.
+        Geometry &geometry();
+
+        // Returns the command at the given index.
+        Command &operator[](int index);
+
+        // Number of commands in the buffer.
+        int size() const;
+
+        // Folds constant work out of the buffer and returns the number of
+        // commands eliminated:
+        //  - rotations about an axis by a constant zero are skipped, and
+        //    transforms that end up being the identity are removed;
+        //  - other constant transforms become MULTIPLY commands, and runs of
+        //    adjacent ones are merged into a single matrix;
+        //  - push/pop pairs with no transform between them are removed.
+        //
+        // DOF bindings to one of the @pinned@ DOFs are treated as constants
+        // with their value in @pose@. The result renders the same for any pose
+        // in which the pinned DOFs have these values.
+        int Fold(const float *pose = 0,
+                 const std::vector<int> &pinned = std::vector<int>());
+
+        // Executes all commands in order for the given pose, starting from
+        // the current OpenGL model view matrix.
+        void Execute(const float *pose);
+
+        // Executes all commands in order for the given pose, starting from
+        // the given view matrix. On return the OpenGL model view matrix is
+        // the one left on top of the stack, which is @view@ for a balanced
+        // buffer.
+        //
+        // Transform commands keep the local and world matrices they computed.
+        // A transform is only recomputed if one of its operands changed since
+        // the last execution; a world matrix is only recomputed if the
+        // transform or anything above it changed.
+        //
+        // Conditions are read once per execution, when their SKIP_UNLESS is
+        // reached. A conditional region that is taken and skipped in turn
+        // counts as a change of the matrix after it, if it transforms at the
+        // depth it starts at; it must not leave the stack deeper or
+        // shallower than that, as for everything @Component::onlyWhen@ is
+        // used on.
+        //
+        // Components called through FUNCTION and UPDATE commands see the
+        // current matrix loaded in OpenGL but must leave it unchanged.
+        void Execute(const Matrix &view, const float *pose);
+
+        // Number of commands that draw (DRAW, FUNCTION and UPDATE commands),
+        // i.e. the number of matrices @Evaluate@ writes.
+        int DrawCount() const;
+
+        // Evaluates only the matrix commands for the given pose, starting from
+        // the given view matrix, and writes the matrix each command that draws
+        // would see to @matrices@, one per command in buffer order. Nothing is
+        // sent to OpenGL. @stack@ is only used as scratch space; it keeps the
+        // depth the buffer needs, so reusing it does not allocate.
+        //
+        // Unlike @Execute@, this neither uses nor updates the transform
+        // caches, so any number of threads may evaluate the same buffer for
+        // different poses at the same time, each with its own stack.
+        //
+        // Conditions are only known when drawing, so commands that a
+        // SKIP_UNLESS may skip are always evaluated, as if they did not
+        // change the matrix of the commands after them. This holds for
+        // everything @Component::onlyWhen@ is used on. The buffer must not
+        // contain UPDATE_TRANSFORM commands, since their effect on the matrix
+        // is only known to OpenGL.
+        void Evaluate(const Matrix &view, const float *pose,
+                      Matrix *matrices, MatrixStack &stack) const;
+
+        // Executes everything but the matrix commands, loading the matrices
+        // written by @Evaluate@ before each command that draws. UPDATE
+        // commands are updated for the given pose. The geometry must be
+        // bound.
+        //
+        // Together these let the matrices of many instances of the same
+        // buffer be evaluated in bulk before any of them is drawn.
+        void Replay(const Matrix *matrices, const float *pose) const;
+
+    private:
+        // Updates @ends_@ and @depth_@ for the current commands, and reserves
+        // that depth.
+        void measure();
+
+        std::vector<Command> commands_;
+        std::vector<TransformCache> caches_;
+        Geometry geometry_;
+
+        // For every command, and the end of the buffer, the number of
+        // conditional regions that end just before it.
+        std::vector<int> ends_;
+
+        // The deepest the matrix stack gets while executing or evaluating the
+        // buffer. Evaluating pushes a level for every conditional region.
+        int depth_;
+
+        // For every SKIP_UNLESS command, whether its region transforms at
+        // the depth it starts at, and whether the last execution took it.
+        std::vector<char> transforms_;
+        std::vector<char> taken_;
+
+        // The matrix stack of @Execute@ and, for each of its levels, whether
+        // the matrix changed since the last execution.
+        MatrixStack stack_;
+        std::vector<char> changed_;
+
+        // The view matrix and number of the last execution, or 1 before the
+        // first one.
+        Matrix view_;
+        unsigned frame_;
+};
+
+// Draws a cuboid with opposite corners @(x1, y1, z1)@ and @(x2, y2, z2)@ using
+// the given primitive mode.
+void drawCuboid(const Command::Box &box);
+
+#endif /* end of include guard: COMMAND_H */
@@ -1,4 +1,5 @@
 #include "component.h"
+#include "command.h"
 #include "gl.h"
 #include <math.h>
 
@@ -15,6 +16,8 @@ class ConstantSupplier : public Supplier<T> {
         ConstantSupplier(T value) { value_ = value; }
         virtual ~ConstantSupplier() { }
         virtual T Get() { return value_; }
+        virtual const T *Address() { return &value_; }
+        virtual bool IsConstant() { return true; }
     private:
         T value_;
 };
@@ -28,6 +31,7 @@ class PointerSupplier : public Supplier<T> {
         PointerSupplier(T *pointer) { pointer_ = pointer; }
         virtual ~PointerSupplier() { }
         virtual T Get() { return *pointer_; }
+        virtual const T *Address() { return pointer_; }
     private:
         T* pointer_;
 };
@@ -46,17 +50,72 @@ class FunctionSupplier : public Supplier<T> {
 
 template <typename T>
 Supplier<T> *Supplier<T>::constant(T value) {
-    return new ConstantSupplier<T>(value);
+    return Arena::create<ConstantSupplier<T>>(value);
 }
 
 template <typename T>
 Supplier<T> *Supplier<T>::pointer(T *ptr) {
-    return new PointerSupplier<T>(ptr);
+    return Arena::create<PointerSupplier<T>>(ptr);
 }
 
 template <typename T>
 Supplier<T> *Supplier<T>::function(T (*f)()) {
-    return new FunctionSupplier<T>(f);
+    return Arena::create<FunctionSupplier<T>>(f);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Binding
+//////////////////////////////////////////////////////////////////////////////
+
+Binding::Binding(Supplier<float> *supplier) {
+    if (supplier == 0) {
+        kind_ = NONE;
+    } else if (supplier->IsConstant()) {
+        kind_ = CONSTANT;
+        value_ = supplier->Get();
+        release(supplier);
+    } else if (supplier->Address() != 0) {
+        kind_ = POINTER;
+        pointer_ = supplier->Address();
+        release(supplier);
+    } else {
+        kind_ = SUPPLIER;
+        supplier_ = supplier;
+    }
+}
+
+Binding Binding::constant(float value) {
+    Binding binding;
+    binding.kind_ = CONSTANT;
+    binding.value_ = value;
+    return binding;
+}
+
+Binding Binding::dof(int index) {
+    Binding binding;
+    binding.kind_ = DOF;
+    binding.dof_ = index;
+    return binding;
+}
+
+Binding Binding::pointer(const float *ptr) {
+    Binding binding;
+    binding.kind_ = POINTER;
+    binding.pointer_ = ptr;
+    return binding;
+}
+
+Binding Binding::function(float (*f)()) {
+    Binding binding;
+    binding.kind_ = FUNCTION;
+    binding.function_ = f;
+    return binding;
+}
+
+void Binding::Release() {
+    if (kind_ == SUPPLIER)
+        release(supplier_);
+    kind_ = NONE;
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -69,150 +128,137 @@ class Cuboid : public Component {
         Cuboid(float x1, float y1, float z1,
                float x2, float y2, float z2,
                GLenum mode = GL_QUADS) {
-            x1_ = x1; y1_ = y1; z1_ = z1;
-            x2_ = x2; y2_ = y2; z2_ = z2;
-            mode_ = mode;
+            box_.x1 = x1; box_.y1 = y1; box_.z1 = z1;
+            box_.x2 = x2; box_.y2 = y2; box_.z2 = z2;
+            box_.mode = mode;
         }
 
 
         Cuboid(float width, float height, float depth,
                GLenum mode = GL_QUADS) {
-            x1_ = -width  / 2; x2_ =  width / 2;
-            y1_ = -height / 2; y2_ = height / 2;
-            z1_ = -depth  / 2; z2_ =  depth / 2;
-            mode_ = mode;
+            box_.x1 = -width  / 2; box_.x2 =  width / 2;
+            box_.y1 = -height / 2; box_.y2 = height / 2;
+            box_.z1 = -depth  / 2; box_.z2 =  depth / 2;
+            box_.mode = mode;
         }
 
         virtual ~Cuboid() {}
 
-        virtual void Update() {
-            glBegin(mode_);
-
-            // draw front face
-            glNormal3f(x1_, y1_, z2_); glVertex3f(x1_, y1_, z2_);
-            glNormal3f(x2_, y1_, z2_); glVertex3f(x2_, y1_, z2_);
-            glNormal3f(x2_, y2_, z2_); glVertex3f(x2_, y2_, z2_);
-            glNormal3f(x1_, y2_, z2_); glVertex3f(x1_, y2_, z2_);
-
-            // draw back face
-            glNormal3f(x2_, y1_, z1_); glVertex3f(x2_, y1_, z1_);
-            glNormal3f(x1_, y1_, z1_); glVertex3f(x1_, y1_, z1_);
-            glNormal3f(x1_, y2_, z1_); glVertex3f(x1_, y2_, z1_);
-            glNormal3f(x2_, y2_, z1_); glVertex3f(x2_, y2_, z1_);
-
-            // draw left face
-            glNormal3f(x1_, y1_, z1_); glVertex3f(x1_, y1_, z1_);
-            glNormal3f(x1_, y1_, z2_); glVertex3f(x1_, y1_, z2_);
-            glNormal3f(x1_, y2_, z2_); glVertex3f(x1_, y2_, z2_);
-            glNormal3f(x1_, y2_, z1_); glVertex3f(x1_, y2_, z1_);
-
-            // draw right face
-            glNormal3f(x2_, y1_, z2_); glVertex3f(x2_, y1_, z2_);
-            glNormal3f(x2_, y1_, z1_); glVertex3f(x2_, y1_, z1_);
-            glNormal3f(x2_, y2_, z1_); glVertex3f(x2_, y2_, z1_);
-            glNormal3f(x2_, y2_, z2_); glVertex3f(x2_, y2_, z2_);
-
-            // draw top
-            glNormal3f(x1_, y2_, z2_); glVertex3f(x1_, y2_, z2_);
-            glNormal3f(x2_, y2_, z2_); glVertex3f(x2_, y2_, z2_);
-            glNormal3f(x2_, y2_, z1_); glVertex3f(x2_, y2_, z1_);
-            glNormal3f(x1_, y2_, z1_); glVertex3f(x1_, y2_, z1_);
-
-            // draw bottom
-            glNormal3f(x1_, y1_, z1_); glVertex3f(x1_, y1_, z1_);
-            glNormal3f(x2_, y1_, z1_); glVertex3f(x2_, y1_, z1_);
-            glNormal3f(x2_, y1_, z2_); glVertex3f(x2_, y1_, z2_);
-            glNormal3f(x1_, y1_, z2_); glVertex3f(x1_, y1_, z2_);
+        virtual void Update(const float *pose) {
+            drawCuboid(box_);
+        }
 
-            glEnd();
+        virtual void Compile(CommandBuffer &buffer) {
+            Command command;
+            command.op = Command::DRAW;
+            command.mesh = buffer.geometry().AddCuboid(
+                    box_.x1, box_.y1, box_.z1,
+                    box_.x2, box_.y2, box_.z2, box_.mode);
+            buffer.Add(command);
         }
 
     private:
-        GLenum mode_;
-        float x1_, y1_, z1_,
-              x2_, y2_, z2_;
+        Command::Box box_;
 };
 
+// Adds a command of the given type that loads its operands from the given
+// bindings.
+static void compileTransform(CommandBuffer &buffer, Command::Op op,
+                             const Binding &x,
+                             const Binding &y,
+                             const Binding &z) {
+    Command command;
+    command.op = op;
+    command.transform.source[0] = x;
+    command.transform.source[1] = y;
+    command.transform.source[2] = z;
+    buffer.Add(command);
+}
+
 // Translates the Model View Matrix.
 class Translatable : public Component {
     public:
-        Translatable(Supplier<float> *x,
-                     Supplier<float> *y,
-                     Supplier<float> *z) {
+        Translatable(Binding x, Binding y, Binding z) {
             x_ = x; y_ = y; z_ = z;
         }
 
         virtual ~Translatable() {
-            delete x_; delete y_; delete z_;
+            x_.Release(); y_.Release(); z_.Release();
+        }
+
+        virtual void Update(const float *pose) {
+            glTranslatef(x_.Get(pose), y_.Get(pose), z_.Get(pose));
         }
 
-        virtual void Update() {
-            glTranslatef(x_->Get(), y_->Get(), z_->Get());
+        virtual void Compile(CommandBuffer &buffer) {
+            compileTransform(buffer, Command::TRANSLATE, x_, y_, z_);
         }
     private:
-        Supplier<float> *x_;
-        Supplier<float> *y_;
-        Supplier<float> *z_;
+        Binding x_;
+        Binding y_;
+        Binding z_;
 };
 
 // A Component that will scale the model view matrix.
 class Scalable : public Component {
     public:
-        Scalable(Supplier<float> *x = 0,
-                 Supplier<float> *y = 0,
-                 Supplier<float> *z = 0) {
-            x_ = x != 0 ? x : Supplier<float>::constant(1.0);
-            y_ = y != 0 ? y : Supplier<float>::constant(1.0);
-            z_ = z != 0 ? z : Supplier<float>::constant(1.0);
+        Scalable(Binding x, Binding y, Binding z) {
+            x_ = x.kind() != Binding::NONE ? x : Binding::constant(1.0);
+            y_ = y.kind() != Binding::NONE ? y : Binding::constant(1.0);
+            z_ = z.kind() != Binding::NONE ? z : Binding::constant(1.0);
         }
 
         virtual ~Scalable() {
-            delete x_; delete y_; delete z_;
+            x_.Release(); y_.Release(); z_.Release();
         }
 
-        virtual void Update() {
-            glScalef(x_->Get(), y_->Get(), z_->Get());
+        virtual void Update(const float *pose) {
+            glScalef(x_.Get(pose), y_.Get(pose), z_.Get(pose));
+        }
+
+        virtual void Compile(CommandBuffer &buffer) {
+            compileTransform(buffer, Command::SCALE, x_, y_, z_);
         }
 
     private:
-        Supplier<float> *x_;
-        Supplier<float> *y_;
-        Supplier<float> *z_;
+        Binding x_;
+        Binding y_;
+        Binding z_;
 };
 
 // Rotates the model view matrix.
 class Rotatable : public Component {
     public:
-        Rotatable(Supplier<float> *angle_x = 0,
-                  Supplier<float> *angle_y = 0,
-                  Supplier<float> *angle_z = 0) {
+        Rotatable(Binding angle_x, Binding angle_y, Binding angle_z) {
             angle_x_ = angle_x;
             angle_y_ = angle_y;
             angle_z_ = angle_z;
         }
 
         virtual ~Rotatable() {
-            if (angle_x_ != 0)
-                delete angle_x_;
-            if (angle_y_ != 0)
-                delete angle_y_;
-            if (angle_z_ != 0)
-                delete angle_z_;
+            angle_x_.Release();
+            angle_y_.Release();
+            angle_z_.Release();
         }
 
-        virtual void Update() {
-            if (angle_z_ != 0)
-                glRotatef(angle_z_->Get(), 0, 0, 1);
-            if (angle_x_ != 0)
-                glRotatef(angle_x_->Get(), 1, 0, 0);
-            if (angle_y_ != 0)
-                glRotatef(angle_y_->Get(), 0, 1, 0);
+        virtual void Update(const float *pose) {
+            if (angle_z_.kind() != Binding::NONE)
+                glRotatef(angle_z_.Get(pose), 0, 0, 1);
+            if (angle_x_.kind() != Binding::NONE)
+                glRotatef(angle_x_.Get(pose), 1, 0, 0);
+            if (angle_y_.kind() != Binding::NONE)
+                glRotatef(angle_y_.Get(pose), 0, 1, 0);
+        }
+
+        virtual void Compile(CommandBuffer &buffer) {
+            compileTransform(buffer, Command::ROTATE,
+                             angle_x_, angle_y_, angle_z_);
         }
 
     private:
-        Supplier<float> *angle_x_;
-        Supplier<float> *angle_y_;
-        Supplier<float> *angle_z_;
+        Binding angle_x_;
+        Binding angle_y_;
+        Binding angle_z_;
 };
 
 // A Component that does not do anything.
@@ -220,7 +266,8 @@ class NilComponent : public Component {
     public:
         NilComponent() {}
         virtual ~NilComponent() {}
-        virtual void Update() {}
+        virtual void Update(const float *pose) {}
+        virtual void Compile(CommandBuffer &buffer) {}
 };
 
 // A Component that calls the given function.
@@ -230,20 +277,54 @@ class FunctionComponent : public Component {
             f_ = f;
         }
         virtual ~FunctionComponent() {}
-        virtual void Update() { (*f_)(); }
+        virtual void Update(const float *pose) { (*f_)(); }
+        virtual void Compile(CommandBuffer &buffer) {
+            Command command;
+            command.op = Command::FUNCTION;
+            command.function = f_;
+            buffer.Add(command);
+        }
     private:
         void (*f_)();
 };
 
+// A Component that pushes or pops the current matrix.
+class MatrixStackComponent : public Component {
+    public:
+        MatrixStackComponent(bool push) {
+            push_ = push;
+        }
+        virtual ~MatrixStackComponent() {}
+        virtual void Update(const float *pose) {
+            if (push_) {
+                glPushMatrix();
+            } else {
+                glPopMatrix();
+            }
+        }
+        virtual void Compile(CommandBuffer &buffer) {
+            buffer.AddOp(push_ ? Command::PUSH_MATRIX : Command::POP_MATRIX);
+        }
+    private:
+        bool push_;
+};
+
 class ColorComponent : public Component {
     public:
         ColorComponent(float r, float g, float b, float a) {
             r_ = r; g_ = g; b_ = b; a_ = a;
         }
         virtual ~ColorComponent() {}
-        virtual void Update() {
+        virtual void Update(const float *pose) {
             glColor4f(r_, g_, b_, a_);
         }
+        virtual void Compile(CommandBuffer &buffer) {
+            Command command;
+            command.op = Command::COLOR;
+            command.color[0] = r_; command.color[1] = g_;
+            command.color[2] = b_; command.color[3] = a_;
+            buffer.Add(command);
+        }
     private:
         float r_, g_, b_, a_;
 };
@@ -255,14 +336,32 @@ class ConditionalComponent : public Component {
             cond_ = cond;
         }
         virtual ~ConditionalComponent() {
-            delete cond_;
-            delete component_;
+            release(cond_);
+            release(component_);
         }
-        virtual void Update() {
+        virtual void Update(const float *pose) {
             if (cond_->Get()) {
-                component_->Update();
+                component_->Update(pose);
             }
         }
+        virtual void Compile(CommandBuffer &buffer) {
+            const bool *condition = cond_->Address();
+            if (condition == 0) {
+                // The wrapped component may transform the matrix.
+                buffer.AddUpdate(this, true);
+                return;
+            }
+
+            // The number of commands to skip is only known once the wrapped
+            // component has been compiled.
+            Command command;
+            command.op = Command::SKIP_UNLESS;
+            command.branch.condition = condition;
+            command.branch.count = 0;
+            int branch = buffer.Add(command);
+            component_->Compile(buffer);
+            buffer[branch].branch.count = buffer.size() - branch - 1;
+        }
     private:
         Component *component_;
         Supplier<bool> *cond_;
@@ -275,7 +374,7 @@ class PolygonOffsetComponent : public Component {
             units_ = units;
         }
         virtual ~PolygonOffsetComponent() {}
-        virtual void Update() {
+        virtual void Update(const float *pose) {
             glPolygonOffset(factor_, units_);
         }
     private:
@@ -289,13 +388,19 @@ class CapabilityComponent : public Component {
             enable_ = enable;
         }
         virtual ~CapabilityComponent() { }
-        virtual void Update() {
+        virtual void Update(const float *pose) {
             if (enable_) {
                 glEnable(cap_);
             } else {
                 glDisable(cap_);
             }
         }
+        virtual void Compile(CommandBuffer &buffer) {
+            Command command;
+            command.op = enable_ ? Command::ENABLE : Command::DISABLE;
+            command.cap = cap_;
+            buffer.Add(command);
+        }
     private:
         GLenum cap_;
         bool enable_;
@@ -308,20 +413,33 @@ class PolygonModeComponent : public Component {
             mode_ = mode;
         }
         virtual ~PolygonModeComponent() {}
-        virtual void Update() {
+        virtual void Update(const float *pose) {
             glPolygonMode(face_, mode_);
         }
     private:
         GLenum face_, mode_;
 };
 
+class ShadeModelComponent : public Component {
+    public:
+        ShadeModelComponent(GLenum mode) {
+            mode_ = mode;
+        }
+        virtual ~ShadeModelComponent() {}
+        virtual void Update(const float *pose) {
+            glShadeModel(mode_);
+        }
+    private:
+        GLenum mode_;
+};
+
 class PushAttributeComponent : public Component {
     public:
         PushAttributeComponent(GLbitfield mask) {
             mask_ = mask;
         }
         virtual ~PushAttributeComponent() {}
-        virtual void Update() {
+        virtual void Update(const float *pose) {
             glPushAttrib(mask_);
         }
     private:
@@ -336,7 +454,7 @@ class LightComponent : public Component {
             params_ = params;
         }
         virtual ~LightComponent() {}
-        virtual void Update() {
+        virtual void Update(const float *pose) {
             glLightfv(light_, pname_, params_);
         }
     private:
@@ -352,7 +470,7 @@ class MaterialfvComponent: public Component {
             params_ = params;
         }
         virtual ~MaterialfvComponent() {}
-        virtual void Update() {
+        virtual void Update(const float *pose) {
             glMaterialfv(face_, pname_, params_);
         }
     private:
@@ -368,7 +486,7 @@ class MaterialfComponent: public Component {
             param_ = param;
         }
         virtual ~MaterialfComponent() {}
-        virtual void Update() {
+        virtual void Update(const float *pose) {
             glMaterialf(face_, pname_, param_);
         }
     private:
@@ -382,7 +500,7 @@ class CircleComponent : public Component {
             x_ = x; y_ = y; z_ = z; r_ = r;
         }
         virtual ~CircleComponent() {}
-        virtual void Update() {
+        virtual void Update(const float *pose) {
             glBegin(GL_POLYGON);
             for (float i = 0; i < 360.0f; i += 4.0) {
                 glNormal3f(0, 0, 1);
@@ -391,18 +509,56 @@ class CircleComponent : public Component {
             }
             glEnd();
         }
+        virtual void Compile(CommandBuffer &buffer) {
+            Command command;
+            command.op = Command::DRAW;
+            command.mesh = buffer.geometry().AddCircle(x_, y_, z_, r_);
+            buffer.Add(command);
+        }
     private:
         float x_, y_, z_, r_;
 };
 
+class WireSphereComponent : public Component {
+    public:
+        WireSphereComponent(float r, int slices, int stacks) : geometry_() {
+            r_ = r; slices_ = slices; stacks_ = stacks;
+            mesh_ = geometry_.AddWireSphere(r, slices, stacks);
+        }
+        virtual ~WireSphereComponent() {}
+        virtual void Update(const float *pose) {
+            geometry_.Bind();
+            geometry_.Draw(mesh_);
+            geometry_.Unbind();
+        }
+        virtual void Compile(CommandBuffer &buffer) {
+            Command command;
+            command.op = Command::DRAW;
+            command.mesh = buffer.geometry().AddWireSphere(r_, slices_,
+                                                           stacks_);
+            buffer.Add(command);
+        }
+    private:
+        float r_;
+        int slices_, stacks_;
+
+        // The sphere on its own, for @Update@.
+        Geometry geometry_;
+        Mesh mesh_;
+};
+
 //////////////////////////////////////////////////////////////////////////////
 // Component
 //////////////////////////////////////////////////////////////////////////////
 
 Component::~Component() { }
 
+void Component::Compile(CommandBuffer &buffer) {
+    buffer.AddUpdate(this);
+}
+
 Wrapper &Component::wrap() {
-    return *(new Wrapper(this));
+    return *Arena::create<Wrapper>(this);
 }
 
 Component *Component::enableDisable(GLenum cap) {
@@ -414,10 +570,9 @@ Component *Component::enableDisable(GLenum cap) {
 static Component *markJoint(bool draw_joint) {
     if (draw_joint) {
         return
-            Component::function([]{
-                    glColor4f(0, 0, 0, 1.0);
-                    glutWireSphere(0.05, 10, 10); })
-            ->pushPopAttribute(GL_COLOR_BUFFER_BIT);
+            (Component::color(0, 0, 0)->wrap()
+                >> Component::wireSphere(0.05, 10, 10))
+            .pushPopAttribute(GL_COLOR_BUFFER_BIT);
     } else {
         return Component::nil();
     }
@@ -430,45 +585,49 @@ Component *Component::polyOffset(float factor, float units, bool *cond) {
 }
 
 Component *Component::polygonMode(GLenum face, GLenum mode) {
-    return new PolygonModeComponent(face, mode);
+    return Arena::create<PolygonModeComponent>(face, mode);
 }
 
 Component *Component::function(void (*f)()) {
     // Preferable to use this for components that are single-line.
-    return new FunctionComponent(f);
+    return Arena::create<FunctionComponent>(f);
 }
 
 Component *Component::color(float r, float g, float b, float a) {
-    return new ColorComponent(r, g, b, a);
+    return Arena::create<ColorComponent>(r, g, b, a);
 }
 
 Component *Component::cuboid(float x1, float y1, float z1,
                              float x2, float y2, float z2) {
-    return new Cuboid(x1, y1, z1, x2, y2, z2);
+    return Arena::create<Cuboid>(x1, y1, z1, x2, y2, z2);
 }
 
 Component *Component::cuboid(float width, float height, float depth) {
-    return new Cuboid(width, height, depth);
+    return Arena::create<Cuboid>(width, height, depth);
 }
 
 Component *Component::pushMatrix() {
-    return Component::function([] { glPushMatrix(); });
+    return Arena::create<MatrixStackComponent>(true);
 }
 
 Component *Component::popMatrix() {
-    return Component::function([] { glPopMatrix(); });
+    return Arena::create<MatrixStackComponent>(false);
 }
 
 Component *Component::polygonOffset(float factor, float units) {
-    return new PolygonOffsetComponent(factor, units);
+    return Arena::create<PolygonOffsetComponent>(factor, units);
 };
 
 Component *Component::enable(GLenum cap) {
-    return new CapabilityComponent(cap, true);
+    return Arena::create<CapabilityComponent>(cap, true);
+}
+
+Entity *Component::entity() {
+    return Arena::create<Entity>();
 }
 
 Component *Component::disable(GLenum cap) {
-    return new CapabilityComponent(cap, false);
+    return Arena::create<CapabilityComponent>(cap, false);
 }
 
 Component *Component::pushPopAttribute(GLbitfield mask) {
@@ -478,13 +637,15 @@ Component *Component::pushPopAttribute(GLbitfield mask) {
 }
 
 Component *Component::pushAttrib(GLbitfield mask) {
-    return new PushAttributeComponent(mask);
+    return Arena::create<PushAttributeComponent>(mask);
 }
 
-Component *Component::scalable(Supplier<float> *x,
-                               Supplier<float> *y,
-                               Supplier<float> *z) {
-    return new Scalable(x, y, z);
+Component *Component::scalable(Binding x, Binding y, Binding z) {
+    return Arena::create<Scalable>(x, y, z);
+}
+
+Component *Component::shadeModel(GLenum mode) {
+    return Arena::create<ShadeModelComponent>(mode);
 }
 
 Component *Component::popAttrib() {
@@ -500,7 +661,7 @@ Component *Component::attach(float x, float y, float z, bool draw_joint) {
 }
 
 Component *Component::onlyWhen(Supplier<bool> *condition) {
-    return new ConditionalComponent(this, condition);
+    return Arena::create<ConditionalComponent>(this, condition);
 }
 
 Component *Component::onlyWhen(bool *condition) {
@@ -508,47 +669,47 @@ Component *Component::onlyWhen(bool *condition) {
 }
 
 Component *Component::translate(float x, float y, float z) {
-    return new Translatable(Supplier<float>::constant(x),
-                            Supplier<float>::constant(y),
-                            Supplier<float>::constant(z));
+    return Arena::create<Translatable>(Binding::constant(x),
+                            Binding::constant(y),
+                            Binding::constant(z));
+}
+
+Component *Component::translatable(Binding x, Binding y, Binding z) {
+    return Arena::create<Translatable>(x, y, z);
 }
 
-Component *Component::translatable(Supplier<float> *x,
-                                   Supplier<float> *y,
-                                   Supplier<float> *z) {
-    return new Translatable(x, y, z);
+Component *Component::wireSphere(float r, int slices, int stacks) {
+    return Arena::create<WireSphereComponent>(r, slices, stacks);
 }
 
 Component *Component::rotate(float x, float y, float z) {
-    return new Rotatable(x != 0 ? Supplier<float>::constant(x) : 0,
-                         y != 0 ? Supplier<float>::constant(y) : 0,
-                         z != 0 ? Supplier<float>::constant(z) : 0);
+    return Arena::create<Rotatable>(x != 0 ? Binding::constant(x) : Binding(),
+                         y != 0 ? Binding::constant(y) : Binding(),
+                         z != 0 ? Binding::constant(z) : Binding());
 }
 
-Component *Component::rotatable(Supplier<float> *x,
-                                Supplier<float> *y,
-                                Supplier<float> *z) {
-    return new Rotatable(x, y, z);
+Component *Component::rotatable(Binding x, Binding y, Binding z) {
+    return Arena::create<Rotatable>(x, y, z);
 }
 
 Component *Component::nil() {
-    return new NilComponent();
+    return Arena::create<NilComponent>();
 }
 
 Component *Component::light(GLenum light, GLenum pname, const GLfloat *params) {
-    return new LightComponent(light, pname, params);
+    return Arena::create<LightComponent>(light, pname, params);
 }
 
 Component *Component::material(GLenum face, GLenum pname, const GLfloat *params) {
-    return new MaterialfvComponent(face, pname, params);
+    return Arena::create<MaterialfvComponent>(face, pname, params);
 }
 
 Component *Component::material(GLenum face, GLenum pname, GLfloat param) {
-    return new MaterialfComponent(face, pname, param);
+    return Arena::create<MaterialfComponent>(face, pname, param);
 }
 
 Component *Component::circle(float x, float y, float z, float r) {
-    return new CircleComponent(x, y, z, r);
+    return Arena::create<CircleComponent>(x, y, z, r);
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -560,7 +721,7 @@ Entity::Entity() : components_() { }
 Entity::~Entity() {
     std::vector<Component*>::iterator it = components_.begin();
     for (; it != components_.end(); it++)
-        delete *it;
+        release(*it);
 }
 
 void Entity::AddComponent(Component *component) {
@@ -572,16 +733,26 @@ void Entity::AddComponent(Component *component) {
  // return *this;
 //}
 
-void Entity::Update() {
+void Entity::Update(const float *pose) {
   glPushMatrix();
 
   std::vector<Component*>::iterator it;
   for (it = components_.begin(); it != components_.end(); it++)
-    (*it)->Update();
+    (*it)->Update(pose);
 
   glPopMatrix();
 }
 
+void Entity::Compile(CommandBuffer &buffer) {
+  buffer.AddOp(Command::PUSH_MATRIX);
+
+  std::vector<Component*>::iterator it;
+  for (it = components_.begin(); it != components_.end(); it++)
+    (*it)->Compile(buffer);
+
+  buffer.AddOp(Command::POP_MATRIX);
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // Wrapper
 //////////////////////////////////////////////////////////////////////////////
@@ -594,10 +765,10 @@ Wrapper::~Wrapper() {
     std::vector<Component*>::iterator it;
 
     for (it = before_.begin(); it != before_.end(); it++)
-        delete *it;
+        release(*it);
 
     for (it = after_.begin(); it != after_.end(); it++)
-        delete *it;
+        release(*it);
 }
 
 void Wrapper::AddPrev(Component *component) {
@@ -618,14 +789,26 @@ Wrapper & Wrapper::operator>>(Component *component) {
     return *this;
 }
 
-void Wrapper::Update() {
+void Wrapper::Update(const float *pose) {
+    std::vector<Component*>::iterator it;
+
+    for (it = before_.begin(); it != before_.end(); it++)
+        (*it)->Update(pose);
+
+    component_->Update(pose);
+
+    for (it = after_.begin(); it != after_.end(); it++)
+        (*it)->Update(pose);
+}
+
+void Wrapper::Compile(CommandBuffer &buffer) {
     std::vector<Component*>::iterator it;
 
     for (it = before_.begin(); it != before_.end(); it++)
-        (*it)->Update();
+        (*it)->Compile(buffer);
 
-    component_->Update();
+    component_->Compile(buffer);
 
     for (it = after_.begin(); it != after_.end(); it++)
-        (*it)->Update();
+        (*it)->Compile(buffer);
 }
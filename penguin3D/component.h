@@ -2,11 +2,15 @@
 #define COMPONENT_H
 
 #include <vector>
+#include "arena.h"
 #include "gl.h"
 
 // A Supplier is an object that supplies a value to components.
+//
+// Suppliers returned by the factories below are allocated in the current
+// arena, if any (see arena.h).
 template <typename T>
-class Supplier {
+class Supplier : public ArenaObject {
     public:
         // Returns the value.
         //
@@ -17,6 +21,16 @@ class Supplier {
         virtual T Get() = 0;
         virtual ~Supplier() {}
 
+        // Returns the address that @Get@ reads the value from, or null if the
+        // value can only be obtained by calling @Get@.
+        //
+        // Compiled components (see command.h) use this to load values
+        // directly instead of making a virtual call per value.
+        virtual const T *Address() { return 0; }
+
+        // Returns true if the value never changes.
+        virtual bool IsConstant() { return false; }
+
         // Returns a Supplier that always returns the given value.
         static Supplier<T>* constant(T value);
 
@@ -29,18 +43,103 @@ class Supplier {
         static Supplier<T>* function(T (*f)());
 };
 
+// A Binding tells a component where to read a float from.
+//
+// Unlike a Supplier, a Binding is a small value stored inline in the component
+// that uses it, and reading it is a switch rather than a virtual call. The
+// bound value can be a constant, a DOF of the pose it is read for, a
+// pointer or a function.
+//
+// A Binding can be constructed from a Supplier so that code written against
+// Suppliers keeps working: constant and addressable suppliers are turned into
+// constant and pointer bindings (and deleted), anything else is kept and
+// called through @Get@. A component that stores a Binding must call @Release@
+// on it when it is destroyed.
+class Binding {
+    public:
+        enum Kind { NONE, CONSTANT, DOF, POINTER, FUNCTION, SUPPLIER };
+
+        // @Binding()@ is a NONE binding, which reads as 0. The constructor is
+        // trivial so that Bindings can be stored in Command unions, which
+        // means a default-initialized Binding is left undefined.
+        Binding() = default;
+
+        // Takes over the given supplier. A null supplier gives a NONE binding.
+        Binding(Supplier<float> *supplier);
+
+        // Returns a Binding to the given value.
+        static Binding constant(float value);
+
+        // Returns a Binding to the given DOF of the pose.
+        static Binding dof(int index);
+
+        // Returns a Binding to the value the given pointer points to.
+        static Binding pointer(const float *ptr);
+
+        // Returns a Binding to the value returned by the given function.
+        static Binding function(float (*f)());
+
+        Kind kind() const { return kind_; }
+        bool IsConstant() const { return kind_ == CONSTANT; }
+
+        // Index of the DOF of a DOF binding.
+        int index() const { return dof_; }
+
+        // Returns the bound value for the given pose. Only DOF bindings
+        // read the pose.
+        float Get(const float *pose) const {
+            switch (kind_) {
+                case CONSTANT: return value_;
+                case DOF:      return pose[dof_];
+                case POINTER:  return *pointer_;
+                case FUNCTION: return (*function_)();
+                case SUPPLIER: return supplier_->Get();
+                default:       return 0;
+            }
+        }
+
+        // Frees what the binding owns, i.e. a supplier it could not convert.
+        void Release();
+
+    private:
+        Kind kind_;
+        union {
+            float value_;
+            int dof_;
+            const float *pointer_;
+            float (*function_)();
+            Supplier<float> *supplier_;
+        };
+};
+
+class CommandBuffer; // Forward declaration.
+class Entity; // Forward declaration.
 class Wrapper; // Forward declaration.
 
 // A Component is the core unit in the system.
-class Component {
+//
+// Components returned by the factories below are allocated in the current
+// arena, if any (see arena.h). Components that own other components free them
+// with @release@, so a tree built in an arena is only freed by the arena.
+class Component : public ArenaObject {
   public:
     // "Update" the component -- whatever that means for the component.
     //
     // This could mean drawing something, transforming the matrix, or maybe
     // doing some form of I/O.
     //
-    // This function is expected to be called every frame.
-    virtual void Update() = 0;
+    // This function is expected to be called every frame. @pose@ holds the
+    // DOFs the component and its children are updated for (see Binding);
+    // nothing about the pose is stored in the component, so the same tree can
+    // be updated for any number of poses.
+    virtual void Update(const float *pose) = 0;
+
+    // Appends the commands equivalent to @Update@ to the given buffer.
+    //
+    // The default implementation adds a command that calls @Update@, so
+    // components only need to override this if they can be expressed with
+    // plain commands.
+    virtual void Compile(CommandBuffer &buffer);
 
     virtual ~Component() = 0;
 
@@ -102,6 +201,9 @@ class Component {
     // A Component that will enable the given OpenGL functionality.
     static Component *enable(GLenum cap);
 
+    // An Entity with no components.
+    static Entity *entity();
+
     // A Component that will call the given function.
     static Component *function(void (*f)());
 
@@ -143,33 +245,38 @@ class Component {
     // A Component that will rotate about the three axes by the given values.
     static Component *rotate(float x = 0, float y = 0, float z = 0);
 
-    // A Component that will rotate about the three axes by the values
-    // supplied by the given suppliers.
+    // A Component that will rotate about the three axes by the bound values.
     //
-    // Null suppliers will cause no rotation about their corresponding axes.
+    // NONE bindings (and null suppliers) will cause no rotation about their
+    // corresponding axes.
     //
     // Rotation about the Z-axis is applied first.
-    static Component *rotatable(Supplier<float> *x = 0,
-                                Supplier<float> *y = 0,
-                                Supplier<float> *z = 0);
+    static Component *rotatable(Binding x = Binding(),
+                                Binding y = Binding(),
+                                Binding z = Binding());
 
-    // A Component that will scale on the three axes by the given values.
-    // Provide the same supplier for all three values for a uniform scale.
+    // A Component that will scale on the three axes by the bound values.
     //
-    // Null suppliers have no effect.
-    static Component *scalable(Supplier<float> *x = 0,
-                               Supplier<float> *y = 0,
-                               Supplier<float> *z = 0);
+    // NONE bindings (and null suppliers) have no effect.
+    static Component *scalable(Binding x = Binding(),
+                               Binding y = Binding(),
+                               Binding z = Binding());
+
+    // A Component that will apply @glShadeModel@ with the given mode.
+    static Component *shadeModel(GLenum mode);
 
     // A Component that will translate on the three axes by the specified
     // values.
     static Component *translate(float x, float y, float z);
 
-    // A Component that will translate on the three axes by the values
-    // supplied by the given suppliers. 
-    static Component *translatable(Supplier<float> *x,
-                                   Supplier<float> *y,
-                                   Supplier<float> *z);
+    // A Component that will translate on the three axes by the bound
+    // values. 
+    static Component *translatable(Binding x, Binding y, Binding z);
+
+    // A Component that will draw a wire frame sphere of radius @r@ around
+    // the origin. It looks like @glutWireSphere(r, slices, stacks)@, but does
+    // not need GLUT to be initialized.
+    static Component *wireSphere(float r, int slices, int stacks);
 };
 
 // An Entity is a component that can contain other components. An Entity
@@ -189,7 +296,8 @@ class Entity : public Component {
 
     // Saves the current matrix, update all child components and restore the
     // matrix.
-    virtual void Update();
+    virtual void Update(const float *pose);
+    virtual void Compile(CommandBuffer &buffer);
 
     // Convenience shorthand for @AddComponent@. Returns a reference to @this@
     // entity, allowing chaining calls.
@@ -219,7 +327,8 @@ class Wrapper : public Component {
 
         // Updates all components added before the wrapped component, updates
         // the wrapped component, and then all components added after it.
-        virtual void Update();
+        virtual void Update(const float *pose);
+        virtual void Compile(CommandBuffer &buffer);
 
         // Add a component to be updated before the wrapped component.
         void AddPrev(Component *component);
@@ -0,0 +1,503 @@
+#include "compressedtrack.h"
+#include "spline.h"
+#include <math.h>
+#include <string.h>
+
+// Where the error is checked in every segment of a track while dropping
+// keys, as fractions of the segment.
+static const float CHECK_POINTS[] = { 0.25f, 0.5f, 0.75f, 1.0f };
+static const int CHECK_POINT_COUNT = 4;
+
+// The error of a channel can peak between check points, so keys are dropped
+// within these fractions of the error in turn, until the channel is within
+// the whole error at VERIFY_POINTS evenly spaced points per segment. Below
+// the last one, only keys the spline does not need at all are dropped.
+static const float FIT_MARGINS[] = { 0.9f, 0.5f, 0.0f };
+static const int FIT_MARGIN_COUNT = 3;
+static const int VERIFY_POINTS = 32;
+
+// Points per segment compressionError samples, twice as many as are
+// verified, so that it reports the error between them too.
+static const int REPORT_POINTS = 64;
+
+// Bits per value of a channel stored as floats, when not even 16 bits keep
+// it within the error.
+static const int FLOAT_BITS = 32;
+
+// Keyframes between two entries of the rank table of a channel.
+static const int RANK_BLOCK = 512;
+
+bool isAngularDOF(int dof) {
+    switch (dof) {
+        case Keyframe::ROOT_TRANSLATE_X:
+        case Keyframe::ROOT_TRANSLATE_Y:
+        case Keyframe::ROOT_TRANSLATE_Z:
+        case Keyframe::R_ELBOW_SCALE:
+        case Keyframe::L_ELBOW_SCALE:
+        case Keyframe::BEAK:
+        case Keyframe::BEAK_USElESS:
+            return false;
+        default:
+            return true;
+    }
+}
+
+// Returns the times of the track as a TrackView, for findKeyframe. The poses
+// of the view must not be used.
+static TrackView timeView(const std::vector<float> &times) {
+    return TrackView(&times[0], sizeof(float), 0, 0, int(times.size()) - 1);
+}
+
+// Returns the value at @time@ of the segment of a channel from the key at
+// keyframe @a@ to the key at keyframe @b@, with values @p0@ and @p1@, where
+// the keys around them are at keyframes @before@ and @after@, with values
+// @prev@ and @next@. The first segment of a channel has @before == a@, and
+// the last one @after == b@. The segment is built like keyframeSegment builds
+// them (see animation.h), except that the tangents are scaled by the number
+// of keyframes the segment spans over the number the keys around its ends
+// span, which is 1 / 2 when no keyframe is left out.
+static float evaluateKeys(const float *times, float time, int before, int a,
+                          int b, int after, float prev, float p0, float p1,
+                          float next) {
+    SplineSegment segment;
+    segment.prev = &prev;
+    segment.p0 = &p0;
+    segment.p1 = &p1;
+    segment.next = &next;
+    segment.s0 = before == a ? 1 : float(b - a) / (b - before);
+    segment.s1 = after == b ? 1 : float(b - a) / (after - a);
+    return evaluateAt(segment, (time - times[a]) / (times[b] - times[a]), 0);
+}
+
+// Returns the value of the given channel of the track at @time@, which is in
+// keyframe segment @i@ as found by findKeyframe. This is what
+// interpolateKeyframes gives for the channel.
+static float trackValue(const TrackView &track, int channel, int i,
+                        float time) {
+    if (i == 0)
+        return track.pose(0)[channel];
+    if (i > track.last())
+        return track.pose(track.last())[channel];
+    float t = (time - track.time(i - 1)) / (track.time(i) - track.time(i - 1));
+    return evaluateAt(keyframeSegment(track, i), t, channel);
+}
+
+// The keys a channel keeps while it is being compressed: a list of keyframe
+// indices, linked both ways, and the quantized values of all keyframes.
+struct KeyList {
+    std::vector<int> prev;
+    std::vector<int> next;
+    std::vector<float> values;
+};
+
+// The times the error is checked at: @times[j]@ is in keyframe segment
+// @segments[j]@, and the checks in segment @i@ start at @first[i]@.
+struct CheckPoints {
+    std::vector<float> times;
+    std::vector<int> segments;
+    std::vector<int> first;
+};
+
+// Makes every keyframe a key of the list.
+static void keepAllKeys(KeyList &keys) {
+    for (size_t i = 0; i < keys.values.size(); i++) {
+        keys.prev[i] = int(i) - 1;
+        keys.next[i] = int(i) + 1;
+    }
+}
+
+// Returns true if the spline through the keys of the list from key @from@ to
+// key @to@ is within @tolerance@ of the values of the original spline at the
+// check points, @original@.
+static bool withinError(const KeyList &keys, const std::vector<float> &times,
+                        const CheckPoints &checks,
+                        const std::vector<float> &original, int from, int to,
+                        float tolerance) {
+    int last = int(times.size()) - 1;
+    for (int a = from; a < to; a = keys.next[a]) {
+        int b = keys.next[a];
+        int before = a > 0 ? keys.prev[a] : a;
+        int after = b < last ? keys.next[b] : b;
+        for (int j = checks.first[a + 1]; j < checks.first[b + 1]; j++) {
+            float value = evaluateKeys(&times[0], checks.times[j], before,
+                                       a, b, after, keys.values[before],
+                                       keys.values[a], keys.values[b],
+                                       keys.values[after]);
+            if (!(fabsf(value - original[j]) <= tolerance))
+                return false;
+        }
+    }
+    return true;
+}
+
+// Drops every key of the list whose neighbours can do without it, keeping
+// the spline through the keys within @tolerance@ of @original@ at the check
+// points. Dropping key k changes the segments from the key before its
+// previous key to the key after its next key.
+static void dropKeys(KeyList &keys, const std::vector<float> &times,
+                     const CheckPoints &checks,
+                     const std::vector<float> &original, float tolerance) {
+    int last = int(times.size()) - 1;
+    for (int k = 1; k < last; k++) {
+        int a = keys.prev[k], b = keys.next[k];
+        if (b - a > CompressedTrack::MAX_KEY_GAP)
+            continue;
+
+        keys.next[a] = b;
+        keys.prev[b] = a;
+        int from = a > 0 ? keys.prev[a] : a;
+        int to = b < last ? keys.next[b] : b;
+        if (!withinError(keys, times, checks, original, from, to,
+                         tolerance)) {
+            keys.next[a] = k;
+            keys.prev[b] = k;
+        }
+    }
+}
+
+// Returns the largest difference between the spline through the keys of the
+// list and the given channel of the track, at the first keyframe and at
+// VERIFY_POINTS evenly spaced points in every segment, and at its start. The
+// start is where a segment after keyframes with the same time leaves the
+// value of the segment before, so the error can peak just after it.
+static float channelError(const TrackView &track, int channel,
+                          const std::vector<float> &times,
+                          const KeyList &keys) {
+    int last = track.last();
+    float error = fabsf(keys.values[0] - track.pose(0)[channel]);
+    for (int a = 0; a < last; a = keys.next[a]) {
+        int b = keys.next[a];
+        int before = a > 0 ? keys.prev[a] : a;
+        int after = b < last ? keys.next[b] : b;
+        for (int i = a + 1; i <= b; i++) {
+            float t0 = times[i - 1], t1 = times[i];
+            if (t0 == t1)
+                continue;
+            for (int p = 0; p <= VERIFY_POINTS; p++) {
+                float time = p < VERIFY_POINTS ?
+                             t0 + (t1 - t0) * p / VERIFY_POINTS : t1;
+                float value = evaluateKeys(&times[0], time, before, a, b,
+                                           after, keys.values[before],
+                                           keys.values[a], keys.values[b],
+                                           keys.values[after]);
+                error = fmaxf(error, fabsf(value - trackValue(track, channel,
+                                                               i, time)));
+            }
+        }
+    }
+    return error;
+}
+
+CompressedTrack::CompressedTrack() : times_(), stream_(), ranks_() {
+    Clear();
+}
+
+void CompressedTrack::Compress(const TrackView &track,
+                               const CompressionSettings &settings) {
+    const int dofs = Keyframe::NUM_JOINT_ENUM;
+    Clear();
+    int last = track.last();
+    if (last < 0)
+        return;
+
+    last_ = last;
+    times_.resize(last + 1);
+    for (int i = 0; i <= last; i++)
+        times_[i] = track.time(i);
+
+    // The check points are ordered by time, so their segments only
+    // increase. Points in segments that are never sampled, between keyframes
+    // with the same time, are left out. The keyframe times themselves are
+    // checked as the ends of their segments.
+    CheckPoints checks;
+    checks.first.assign(last + 2, 0);
+    for (int i = 1; i <= last; i++) {
+        for (int p = 0; p < CHECK_POINT_COUNT; p++) {
+            float t0 = times_[i - 1], t1 = times_[i];
+            float time = p + 1 < CHECK_POINT_COUNT ?
+                         t0 + CHECK_POINTS[p] * (t1 - t0) : t1;
+            int segment = findKeyframe(timeView(times_), time);
+            if (segment == 0 || segment > last || t0 == t1)
+                continue;
+            checks.times.push_back(time);
+            checks.segments.push_back(segment);
+        }
+    }
+    for (int i = 0, j = 0; i <= last + 1; i++) {
+        while (j < int(checks.segments.size()) && checks.segments[j] < i)
+            j++;
+        checks.first[i] = j;
+    }
+
+    std::vector<uint32_t> quantized(last + 1);
+    std::vector<float> original(checks.times.size());
+    std::vector<char> kept(last + 1);
+    KeyList keys;
+    keys.prev.resize(last + 1);
+    keys.next.resize(last + 1);
+    keys.values.resize(last + 1);
+
+    for (int c = 0; c < dofs; c++) {
+        Channel &channel = channels_[c];
+        float low = track.pose(0)[c], high = low;
+        for (int i = 1; i <= last; i++) {
+            low = fminf(low, track.pose(i)[c]);
+            high = fmaxf(high, track.pose(i)[c]);
+        }
+        channel.offset = low;
+        channel.step = 0;
+        channel.bits = 0;
+        channel.keys = 0;
+        channel.flags = 0;
+        channel.values = 0;
+        channel.ranks = 0;
+        if (low == high)
+            continue;
+
+        for (size_t j = 0; j < checks.times.size(); j++) {
+            original[j] = trackValue(track, c, checks.segments[j],
+                                     checks.times[j]);
+        }
+
+        // Quantize the values, and drop keys within less and less of the
+        // error until the channel is within all of it. If it is not even
+        // with every key that matters, its values need more bits.
+        float tolerance = isAngularDOF(c) ? settings.angularError
+                                          : settings.positionalError;
+        for (channel.bits = settings.bits; ; ) {
+            if (channel.bits == FLOAT_BITS) {
+                channel.offset = 0;
+                channel.step = 0;
+                for (int i = 0; i <= last; i++) {
+                    keys.values[i] = track.pose(i)[c];
+                    memcpy(&quantized[i], &keys.values[i], sizeof(float));
+                }
+            } else {
+                const uint32_t largest = (uint32_t(1) << channel.bits) - 1;
+                channel.step = (high - low) / largest;
+                for (int i = 0; i <= last; i++) {
+                    long q = lrintf((track.pose(i)[c] - low) / channel.step);
+                    quantized[i] = q < 0 ? 0 :
+                                   (uint32_t(q) > largest ? largest : q);
+                    keys.values[i] = low + channel.step * quantized[i];
+                }
+            }
+
+            bool within = false;
+            for (int m = 0; !within && m < FIT_MARGIN_COUNT; m++) {
+                keepAllKeys(keys);
+                dropKeys(keys, times_, checks, original,
+                         tolerance * FIT_MARGINS[m]);
+                within = channelError(track, c, times_, keys) <= tolerance;
+            }
+            if (within || channel.bits == FLOAT_BITS)
+                break;
+            channel.bits = channel.bits < 16 ? 16 : FLOAT_BITS;
+        }
+
+        // Write the flags, counting the keys before every block of them,
+        // then the values of the keys.
+        kept.assign(last + 1, 0);
+        for (int i = 0; i <= last; i = keys.next[i])
+            kept[i] = 1;
+        streamBits_ = (streamBits_ + 63) / 64 * 64;
+        channel.flags = streamBits_;
+        channel.ranks = ranks_.size();
+        for (int i = 0; i <= last; i++) {
+            if (i % RANK_BLOCK == 0)
+                ranks_.push_back(channel.keys);
+            write(kept[i], 1);
+            channel.keys += kept[i];
+        }
+        channel.values = streamBits_;
+        for (int i = 0; i <= last; i = keys.next[i])
+            write(quantized[i], channel.bits);
+    }
+}
+
+void CompressedTrack::Clear() {
+    last_ = -1;
+    times_.clear();
+    Keyframe::Pose pose = Keyframe().getDOFVector();
+    for (int c = 0; c < Keyframe::NUM_JOINT_ENUM; c++) {
+        channels_[c].offset = pose[c];
+        channels_[c].step = 0;
+        channels_[c].bits = 0;
+        channels_[c].keys = 0;
+        channels_[c].flags = 0;
+        channels_[c].values = 0;
+        channels_[c].ranks = 0;
+    }
+    stream_.clear();
+    streamBits_ = 0;
+    ranks_.clear();
+}
+
+int CompressedTrack::size() const {
+    return last_ + 1;
+}
+
+float CompressedTrack::duration() const {
+    return last_ >= 0 ? times_[last_] : 0;
+}
+
+int CompressedTrack::bits(int channel) const {
+    return channels_[channel].bits;
+}
+
+int CompressedTrack::keyCount() const {
+    int count = 0;
+    for (int c = 0; c < Keyframe::NUM_JOINT_ENUM; c++)
+        count += channels_[c].keys;
+    return count;
+}
+
+size_t CompressedTrack::bytes() const {
+    return times_.size() * sizeof(float) + stream_.size() * sizeof(uint64_t) +
+           ranks_.size() * sizeof(uint32_t) + sizeof(channels_);
+}
+
+uint32_t CompressedTrack::read(uint64_t offset, int bits) const {
+    if (bits == 0)
+        return 0;
+
+    // The stream ends with a spare word, so the next word can always be read.
+    size_t word = offset / 64;
+    int shift = offset % 64;
+    uint64_t value = stream_[word] >> shift;
+    if (shift + bits > 64)
+        value |= stream_[word + 1] << (64 - shift);
+    return uint32_t(value & ((uint64_t(1) << bits) - 1));
+}
+
+void CompressedTrack::write(uint32_t value, int bits) {
+    if (bits == 0)
+        return;
+
+    size_t word = streamBits_ / 64;
+    int shift = streamBits_ % 64;
+    stream_.resize(word + 2, 0);
+    stream_[word] |= uint64_t(value) << shift;
+    if (shift + bits > 64)
+        stream_[word + 1] |= uint64_t(value) >> (64 - shift);
+    streamBits_ += bits;
+}
+
+int CompressedTrack::rank(const Channel &channel, int i) const {
+    const uint64_t *flags = &stream_[channel.flags / 64];
+    int count = ranks_[channel.ranks + i / RANK_BLOCK];
+    for (int w = i / RANK_BLOCK * (RANK_BLOCK / 64); w < i / 64; w++)
+        count += __builtin_popcountll(flags[w]);
+    if (i % 64 != 0)
+        count += __builtin_popcountll(flags[i / 64] &
+                                      ((uint64_t(1) << (i % 64)) - 1));
+    return count;
+}
+
+int CompressedTrack::previousKey(const Channel &channel, int i) const {
+    const uint64_t *flags = &stream_[channel.flags / 64];
+    int w = i / 64;
+    uint64_t word = flags[w] & ((uint64_t(1) << (i % 64)) - 1);
+    while (word == 0)
+        word = flags[--w];
+    return w * 64 + 63 - __builtin_clzll(word);
+}
+
+int CompressedTrack::nextKey(const Channel &channel, int i) const {
+    const uint64_t *flags = &stream_[channel.flags / 64];
+    int w = i / 64;
+    uint64_t word = flags[w] & (~uint64_t(0) << (i % 64));
+    while (word == 0)
+        word = flags[++w];
+    return w * 64 + __builtin_ctzll(word);
+}
+
+float CompressedTrack::keyValue(const Channel &channel, int k) const {
+    uint32_t q = read(channel.values + uint64_t(k) * channel.bits,
+                      channel.bits);
+    if (channel.bits == FLOAT_BITS) {
+        float value;
+        memcpy(&value, &q, sizeof(value));
+        return value;
+    }
+    return channel.offset + channel.step * q;
+}
+
+void CompressedTrack::samplePose(float time, float *pose) const {
+    const int dofs = Keyframe::NUM_JOINT_ENUM;
+    if (last_ < 0) {
+        memcpy(pose, Keyframe().getDOFVector().getData(), dofs * sizeof(float));
+        return;
+    }
+
+    int i = findKeyframe(timeView(times_), time);
+    for (int c = 0; c < dofs; c++) {
+        const Channel &channel = channels_[c];
+        int keys = channel.keys;
+        if (keys == 0) {
+            pose[c] = channel.offset;
+            continue;
+        }
+        if (i == 0) {
+            pose[c] = keyValue(channel, 0);
+            continue;
+        }
+        if (i > last_) {
+            pose[c] = keyValue(channel, keys - 1);
+            continue;
+        }
+
+        // The keys around keyframe segment i: the last key before keyframe
+        // i, and the first at or after it, which is key k. Keyframe 0 and
+        // the last keyframe are always keys.
+        int a = previousKey(channel, i);
+        int b = nextKey(channel, i);
+        int before = a > 0 ? previousKey(channel, a) : a;
+        int after = b < last_ ? nextKey(channel, b + 1) : b;
+        int k = rank(channel, b);
+        float p0 = keyValue(channel, k - 1);
+        float p1 = keyValue(channel, k);
+        float prev = a > 0 ? keyValue(channel, k - 2) : p0;
+        float next = b < last_ ? keyValue(channel, k + 1) : p1;
+        pose[c] = evaluateKeys(&times_[0], time, before, a, b, after, prev,
+                               p0, p1, next);
+    }
+}
+
+Keyframe::Pose CompressedTrack::Sample(float time) const {
+    Keyframe::Pose pose;
+    samplePose(time, pose.getData());
+    return pose;
+}
+
+void CompressedTrack::Sample(const float *times, int count,
+                             float *poses) const {
+    for (int i = 0; i < count; i++)
+        samplePose(times[i], poses + i * Keyframe::NUM_JOINT_ENUM);
+}
+
+void compressionError(const TrackView &track, const CompressedTrack &compressed,
+                      float *angular, float *positional) {
+    *angular = 0;
+    *positional = 0;
+    for (int i = 0; i <= track.last(); i++) {
+        for (int p = 1; p <= REPORT_POINTS; p++) {
+            // Check the first keyframe, then points evenly spaced in every
+            // segment, up to the keyframe at its end.
+            if (i == 0 && p > 1)
+                break;
+            float time = track.time(i);
+            if (i > 0 && p < REPORT_POINTS) {
+                float t0 = track.time(i - 1);
+                time = t0 + (time - t0) * p / REPORT_POINTS;
+            }
+
+            Keyframe::Pose want = interpolateKeyframes(track, time);
+            Keyframe::Pose have = compressed.Sample(time);
+            for (int dof = 0; dof < Keyframe::NUM_JOINT_ENUM; dof++) {
+                float *largest = isAngularDOF(dof) ? angular : positional;
+                *largest = fmaxf(*largest, fabsf(want[dof] - have[dof]));
+            }
+        }
+    }
+}
@@ -0,0 +1,145 @@
+#ifndef COMPRESSEDTRACK_H
+#define COMPRESSEDTRACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "animation.h"
+
+// How much a compressed animation may differ from the one it was compressed
+// from, and how its values are stored.
+struct CompressionSettings {
+    float angularError;     // largest error of rotation DOFs, in degrees
+    float positionalError;  // largest error of the other DOFs, e.g. the
+                            // root translation, in their own units
+    int bits;               // bits per value: 12 or 16, or more for
+                            // channels that need them (see below)
+};
+
+// Returns true if the given DOF is an angle, e.g. HEAD_YAW, rather than a
+// position or scale, e.g. ROOT_TRANSLATE_X.
+bool isAngularDOF(int dof);
+
+// A CompressedTrack is a track of keyframes compressed within a given error,
+// and sampled as it is, without expanding it first.
+//
+// Each DOF channel keeps only the keyframes it needs: a keyframe is dropped
+// if the spline through the remaining keys stays within part of the error of
+// the original spline, checked a few times per segment, with the values of
+// the keys quantized to @bits@ bits between the smallest and largest value of
+// the channel. The channel is then checked at many more points per segment,
+// and compressed again within less of the error if it went over between the
+// first ones. A channel whose range is too wide for its values to be within
+// the error in @bits@ bits takes 16 bits, or failing that, floats. Since the
+// keys a channel keeps are not evenly spaced, the tangents of its spline are
+// scaled by the number of keyframes between the keys; with every keyframe
+// kept, this is the spline of the keyframes.
+//
+// Each channel is packed into a stream of bits: a bit per keyframe telling
+// if the channel keeps it, then the quantized values of the keys it keeps. A
+// channel with the same value in every keyframe keeps nothing but that
+// value. The times of the keyframes are kept once, as floats.
+//
+// Sampling finds the keyframe segment of the time with a binary search on the
+// times. The keys around it in a channel are found with a table of how many
+// keys the channel keeps before every 512 keyframes, and then a few words of
+// bits, so sampling takes O(log n) and decodes only the keys it uses.
+class CompressedTrack {
+    public:
+        // Keyframes a channel can skip at once. Bounds the time compression
+        // takes, which checks all the keyframes between two keys.
+        enum { MAX_KEY_GAP = 256 };
+
+        CompressedTrack();
+
+        // Replaces the track with the given track compressed with the given
+        // settings.
+        void Compress(const TrackView &track,
+                      const CompressionSettings &settings);
+
+        // Removes all keyframes, as if compressing an empty track.
+        void Clear();
+
+        // Number of keyframes of the track that was compressed.
+        int size() const;
+
+        // Time of the last keyframe, or 0 if the track is empty.
+        float duration() const;
+
+        // Number of keys all channels keep.
+        int keyCount() const;
+
+        // Bits per value of the given channel: those of the settings, 16 or
+        // 32 (floats) if it needed more, or 0 if it is constant.
+        int bits(int channel) const;
+
+        // Bytes taken by the times, the packed channels, their rank tables
+        // and their headers.
+        size_t bytes() const;
+
+        // Returns the pose at the given time. An empty track gives the
+        // default pose.
+        Keyframe::Pose Sample(float time) const;
+
+        // Writes the poses at @count@ times to @poses@, one pose of
+        // @Keyframe::NUM_JOINT_ENUM@ values after the other.
+        void Sample(const float *times, int count, float *poses) const;
+
+    private:
+        CompressedTrack(const CompressedTrack &);
+        CompressedTrack &operator =(const CompressedTrack &);
+
+        // A channel. Its flags, a bit per keyframe, start at bit @flags@ of
+        // the stream, which is the start of a word, and its values, of
+        // @bits@ bits each, at bit @values@. The number of keys before
+        // keyframe @512 * i@ is @ranks_[ranks + i]@. The value of quantized
+        // value @q@ is @offset + step * q@, except that values of 32 bits are
+        // floats. A constant channel has no keys, and its value is @offset@.
+        struct Channel {
+            float offset;
+            float step;
+            int bits;
+            int keys;
+            uint64_t flags;
+            uint64_t values;
+            size_t ranks;
+        };
+
+        // Returns the @bits@ bits at bit @offset@ of the stream.
+        uint32_t read(uint64_t offset, int bits) const;
+
+        // Appends the lowest @bits@ bits of @value@ to the stream.
+        void write(uint32_t value, int bits);
+
+        // Returns the number of keys of the channel before keyframe @i@.
+        int rank(const Channel &channel, int i) const;
+
+        // Returns the last key of the channel before keyframe @i@, which
+        // must be after the first keyframe, and the first key at or after
+        // it, which must not be after the last one.
+        int previousKey(const Channel &channel, int i) const;
+        int nextKey(const Channel &channel, int i) const;
+
+        // Returns the value of key @k@ of the channel.
+        float keyValue(const Channel &channel, int k) const;
+
+        // Writes the pose at the given time to @pose@.
+        void samplePose(float time, float *pose) const;
+
+        int last_;
+        std::vector<float> times_;
+        Channel channels_[Keyframe::NUM_JOINT_ENUM];
+
+        std::vector<uint64_t> stream_;
+        uint64_t streamBits_;
+        std::vector<uint32_t> ranks_;
+};
+
+// Returns the largest difference between the poses of the given track and of
+// its compressed version, for the angular and for the other DOFs (see
+// isAngularDOF). The poses are sampled at the first keyframe and at 64 evenly
+// spaced points in every segment, twice as many as compressing checks.
+void compressionError(const TrackView &track, const CompressedTrack &compressed,
+                      float *angular, float *positional);
+
+#endif /* end of include guard: COMPRESSEDTRACK_H */
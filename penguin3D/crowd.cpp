@@ -0,0 +1,110 @@
+#include "crowd.h"
+#include "component.h"
+#include "gl.h"
+#include <math.h>
+
+// A small deterministic generator, so that populating a crowd does not depend
+// on (or disturb) the state of rand().
+static float nextRandom(unsigned &state) {
+    state = state * 1664525u + 1013904223u;
+    return (state >> 8) / float(1 << 24);
+}
+
+// The state @nextRandom@ starts from when populating a crowd.
+static const unsigned SEED = 418;
+
+Crowd::Crowd(CommandBuffer &rig, int dofs, PoseFunction pose, float duration)
+    : rig_(rig), members_(), times_(), poses_(), matrices_(), stack_() {
+    dofs_ = dofs;
+    pose_ = pose;
+    duration_ = duration;
+    view_ = Matrix::identity();
+}
+
+void Crowd::Populate(int count, float spacing) {
+    int columns = int(ceilf(sqrtf(count)));
+    unsigned state = SEED;
+
+    members_.resize(count);
+    for (int i = 0; i < count; i++) {
+        CrowdMember &member = members_[i];
+        member.root = Matrix::identity();
+        member.root.translate((i % columns - (columns - 1) / 2.0f) * spacing,
+                              0, -(i / columns) * spacing);
+        member.offset = nextRandom(state) * duration_;
+        member.speed = 0.8f + 0.4f * nextRandom(state);
+    }
+}
+
+void Crowd::SetDuration(float duration) {
+    duration_ = duration;
+
+    // Same sequence as Populate, skipping the speeds.
+    unsigned state = SEED;
+    for (size_t i = 0; i < members_.size(); i++) {
+        members_[i].offset = nextRandom(state) * duration_;
+        nextRandom(state);
+    }
+}
+
+int Crowd::size() const {
+    return members_.size();
+}
+
+CrowdMember &Crowd::operator[](int index) {
+    return members_[index];
+}
+
+void Crowd::Update(float time, const Matrix &view) {
+    int count = members_.size();
+    times_.resize(count);
+    poses_.resize(count * dofs_);
+    if (count > 0)
+        Pose(time, &times_[0], &poses_[0]);
+    evaluate(view);
+}
+
+void Crowd::Pose(float time, float *times, float *poses) const {
+    int count = members_.size();
+
+    // All poses in one call, so that evaluating the rig reads them from one
+    // contiguous array.
+    for (int i = 0; i < count; i++) {
+        const CrowdMember &member = members_[i];
+        float t = time * member.speed + member.offset;
+        if (duration_ > 0)
+            t = fmodf(t, duration_);
+        times[i] = t;
+    }
+    if (count > 0)
+        (*pose_)(times, count, poses);
+}
+
+void Crowd::Update(const float *poses, const Matrix &view) {
+    poses_.assign(poses, poses + members_.size() * dofs_);
+    evaluate(view);
+}
+
+void Crowd::evaluate(const Matrix &view) {
+    int count = members_.size();
+    int matrices = rig_.DrawCount();
+    view_ = view;
+    matrices_.resize(count * matrices);
+
+    for (int i = 0; i < count; i++) {
+        rig_.Evaluate(Matrix::multiply(view, members_[i].root),
+                      &poses_[i * dofs_], &matrices_[i * matrices], stack_);
+    }
+}
+
+void Crowd::Draw() {
+    int count = members_.size();
+    int matrices = rig_.DrawCount();
+
+    rig_.geometry().Bind();
+    for (int i = 0; i < count; i++)
+        rig_.Replay(&matrices_[i * matrices], &poses_[i * dofs_]);
+    rig_.geometry().Unbind();
+
+    glLoadMatrixf(view_.m);
+}
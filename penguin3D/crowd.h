@@ -0,0 +1,95 @@
+#ifndef CROWD_H
+#define CROWD_H
+
+#include <vector>
+#include "command.h"
+#include "matrix.h"
+
+// A member of a Crowd.
+struct CrowdMember {
+    Matrix root;    // Placement of the member relative to the crowd.
+    float offset;   // Time offset into the animation, in seconds.
+    float speed;    // Playback speed; 1 plays the keyframes as authored.
+};
+
+// A Crowd draws many copies of one compiled rig, each with its own placement
+// and its own time in a shared animation.
+//
+// Every frame is done in two passes. @Update@ computes the poses of all
+// members and evaluates the matrices of the rig for each of them into one
+// contiguous array; @Draw@ then replays the rig once per member with the
+// geometry bound only once. The first pass never touches OpenGL, so it can
+// run (and be measured) without a window.
+//
+// The poses can also be computed apart, with @Pose@, which only reads the
+// members and the animation, e.g. on another thread, and then given to
+// @Update@.
+class Crowd {
+    public:
+        // Fills @poses@ with the DOFs of the animation at @count@ times, one
+        // pose after the other.
+        typedef void (*PoseFunction)(const float *times, int count,
+                                     float *poses);
+
+        // Constructs an empty crowd of the given rig. DOF bindings of the rig
+        // read poses of @dofs@ values computed by @pose@, and the animation
+        // loops every @duration@ seconds.
+        Crowd(CommandBuffer &rig, int dofs, PoseFunction pose, float duration);
+
+        // Replaces the members with @count@ members on a square grid with the
+        // given spacing, each with a random time offset and speed. The grid
+        // is centered on the X axis and extends away from the viewer along
+        // -Z. The same count always gives the same crowd.
+        void Populate(int count, float spacing);
+
+        // Changes the duration of the animation to @duration@ seconds, e.g.
+        // after its keyframes changed, and spreads the time offsets of the
+        // members over it again the way @Populate@ does.
+        void SetDuration(float duration);
+
+        // Number of members.
+        int size() const;
+
+        // Returns the member at the given index.
+        CrowdMember &operator[](int index);
+
+        // Computes the poses and matrices of all members at the given time as
+        // seen from @view@.
+        void Update(float time, const Matrix &view);
+
+        // Writes the animation time and the pose of every member at the
+        // given time to @times@ and @poses@, one pose after the other.
+        void Pose(float time, float *times, float *poses) const;
+
+        // Computes the matrices of all members as seen from @view@, with
+        // the poses computed by @Pose@.
+        void Update(const float *poses, const Matrix &view);
+
+        // Draws all members as computed by the last @Update@. The OpenGL
+        // model view matrix is @view@ on return.
+        void Draw();
+
+    private:
+        // Evaluates the matrices of all members for @poses_@ as seen from
+        // @view@.
+        void evaluate(const Matrix &view);
+
+        CommandBuffer &rig_;
+        int dofs_;
+        PoseFunction pose_;
+        float duration_;
+
+        Matrix view_;
+        std::vector<CrowdMember> members_;
+
+        // Animation time and @dofs_@ values per member.
+        std::vector<float> times_;
+        std::vector<float> poses_;
+
+        // @rig_.DrawCount()@ matrices per member, and the stack they are
+        // evaluated with.
+        std::vector<Matrix> matrices_;
+        MatrixStack stack_;
+};
+
+#endif /* end of include guard: CROWD_H */
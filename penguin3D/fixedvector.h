@@ -0,0 +1,201 @@
+#ifndef FIXEDVECTOR_H
+#define FIXEDVECTOR_H
+
+#include <assert.h>
+#include <math.h>
+
+// Arithmetic on FixedVectors is lazy: @a * 2 + b@ does not compute anything
+// but returns an expression node that refers to @a@ and @b@. The expression is
+// only evaluated when it is assigned to a FixedVector (or used to construct
+// one), in a single loop over the values with no temporary vectors, however
+// many operators it has.
+//
+// Every operation is element-wise, so assigning an expression to a vector it
+// refers to, e.g. @a = a * 2 + b@, is fine.
+
+// Base class of vector expressions. @E@ is the actual expression type, which
+// must have a @DIM@ constant and a const @operator[]@.
+template <typename E>
+class VectorExpression {
+    public:
+        const E &self() const { return static_cast<const E &>(*this); }
+};
+
+template <int D> class FixedVector; // Forward declaration.
+
+// How an expression node stores its operands: nodes by value, since they are
+// usually temporaries, and vectors by reference.
+template <typename E>
+struct VectorOperand { typedef const E type; };
+
+template <int D>
+struct VectorOperand<FixedVector<D> > { typedef const FixedVector<D> &type; };
+
+// A FixedVector is a vector of @D@ floats with the same operations as Vector
+// (see vector.h), but with its dimension fixed at compile time and its values
+// stored inline, so that creating, copying or moving one never allocates.
+//
+// The values are 16-byte aligned so that they can be loaded as whole SIMD
+// registers. Copying and moving are the same plain copy of the values, which
+// is what the implicit copy and move operations do.
+//
+// Keyframe::Pose, the pose vector of a keyframe, is a FixedVector.
+template <int D>
+class FixedVector : public VectorExpression<FixedVector<D> > {
+    public:
+        enum { DIM = D };
+
+        // A vector of zeros.
+        FixedVector() {
+            for (int i = 0; i < D; i++)
+                v_[i] = 0;
+        }
+
+        // Evaluates the given expression.
+        template <typename E>
+        FixedVector(const VectorExpression<E> &expression) {
+            *this = expression;
+        }
+
+        template <typename E>
+        FixedVector &operator=(const VectorExpression<E> &expression) {
+            static_assert(int(E::DIM) == D, "dimensions differ");
+            const E &e = expression.self();
+            for (int i = 0; i < D; i++)
+                v_[i] = e[i];
+            return *this;
+        }
+
+        float &operator[](int index) {
+            assert(index >= 0 && index < D);
+            return v_[index];
+        }
+
+        const float &operator[](int index) const {
+            assert(index >= 0 && index < D);
+            return v_[index];
+        }
+
+        template <typename E>
+        FixedVector &operator+=(const VectorExpression<E> &expression) {
+            static_assert(int(E::DIM) == D, "dimensions differ");
+            const E &e = expression.self();
+            for (int i = 0; i < D; i++)
+                v_[i] += e[i];
+            return *this;
+        }
+
+        template <typename E>
+        FixedVector &operator-=(const VectorExpression<E> &expression) {
+            static_assert(int(E::DIM) == D, "dimensions differ");
+            const E &e = expression.self();
+            for (int i = 0; i < D; i++)
+                v_[i] -= e[i];
+            return *this;
+        }
+
+        FixedVector &operator*=(float scalar) {
+            for (int i = 0; i < D; i++)
+                v_[i] *= scalar;
+            return *this;
+        }
+
+        // Like Vector, dividing by (nearly) zero leaves the vector unchanged.
+        FixedVector &operator/=(float scalar) {
+            if (fabs(scalar) > 0.0001f) {
+                for (int i = 0; i < D; i++)
+                    v_[i] /= scalar;
+            }
+            return *this;
+        }
+
+        int getDim() const { return D; }
+        float *getData() { return v_; }
+        const float *getData() const { return v_; }
+
+    private:
+        alignas(16) float v_[D];
+};
+
+// @l + r@, element-wise.
+template <typename L, typename R>
+class VectorSum : public VectorExpression<VectorSum<L, R> > {
+    public:
+        enum { DIM = L::DIM };
+        static_assert(int(L::DIM) == int(R::DIM), "dimensions differ");
+
+        VectorSum(const L &l, const R &r) : l_(l), r_(r) { }
+        float operator[](int index) const { return l_[index] + r_[index]; }
+
+    private:
+        typename VectorOperand<L>::type l_;
+        typename VectorOperand<R>::type r_;
+};
+
+// @l - r@, element-wise.
+template <typename L, typename R>
+class VectorDifference : public VectorExpression<VectorDifference<L, R> > {
+    public:
+        enum { DIM = L::DIM };
+        static_assert(int(L::DIM) == int(R::DIM), "dimensions differ");
+
+        VectorDifference(const L &l, const R &r) : l_(l), r_(r) { }
+        float operator[](int index) const { return l_[index] - r_[index]; }
+
+    private:
+        typename VectorOperand<L>::type l_;
+        typename VectorOperand<R>::type r_;
+};
+
+// @e * scalar@.
+template <typename E>
+class VectorProduct : public VectorExpression<VectorProduct<E> > {
+    public:
+        enum { DIM = E::DIM };
+
+        VectorProduct(const E &e, float scalar) : e_(e), scalar_(scalar) { }
+        float operator[](int index) const { return e_[index] * scalar_; }
+
+    private:
+        typename VectorOperand<E>::type e_;
+        float scalar_;
+};
+
+// @e / scalar@, or just @e@ if the scalar is (nearly) zero.
+template <typename E>
+class VectorQuotient : public VectorExpression<VectorQuotient<E> > {
+    public:
+        enum { DIM = E::DIM };
+
+        VectorQuotient(const E &e, float scalar)
+            : e_(e), scalar_(fabs(scalar) > 0.0001f ? scalar : 1) { }
+        float operator[](int index) const { return e_[index] / scalar_; }
+
+    private:
+        typename VectorOperand<E>::type e_;
+        float scalar_;
+};
+
+template <typename L, typename R>
+VectorSum<L, R> operator+(const VectorExpression<L> &l,
+                          const VectorExpression<R> &r) {
+    return VectorSum<L, R>(l.self(), r.self());
+}
+
+template <typename L, typename R>
+VectorDifference<L, R> operator-(const VectorExpression<L> &l,
+                                 const VectorExpression<R> &r) {
+    return VectorDifference<L, R>(l.self(), r.self());
+}
+
+template <typename E>
+VectorProduct<E> operator*(const VectorExpression<E> &e, float scalar) {
+    return VectorProduct<E>(e.self(), scalar);
+}
+
+template <typename E>
+VectorQuotient<E> operator/(const VectorExpression<E> &e, float scalar) {
+    return VectorQuotient<E>(e.self(), scalar);
+}
+
+#endif /* end of include guard: FIXEDVECTOR_H */
@@ -0,0 +1,138 @@
+#include "geometry.h"
+#include <math.h>
+
+inline float deg2rad(float deg) { return deg * M_PI / 180; }
+
+// Corners of a cuboid for each face, in the order drawCuboid draws them. Bit
+// 0, 1 and 2 of a corner select the second x, y and z coordinate.
+static const GLuint CUBOID_FACES[6][4] = {
+    { 4, 5, 7, 6 }, // front
+    { 1, 0, 2, 3 }, // back
+    { 0, 4, 6, 2 }, // left
+    { 5, 1, 3, 7 }, // right
+    { 6, 7, 3, 2 }, // top
+    { 0, 1, 5, 4 }, // bottom
+};
+
+Geometry::Geometry() : vertices_(), indices_() { }
+
+void Geometry::Clear() {
+    vertices_.clear();
+    indices_.clear();
+}
+
+GLuint Geometry::AddVertex(float x, float y, float z,
+                           float nx, float ny, float nz) {
+    Vertex vertex;
+    vertex.position[0] = x;  vertex.position[1] = y;  vertex.position[2] = z;
+    vertex.normal[0] = nx;   vertex.normal[1] = ny;   vertex.normal[2] = nz;
+    vertices_.push_back(vertex);
+    return vertices_.size() - 1;
+}
+
+Mesh Geometry::AddCuboid(float x1, float y1, float z1,
+                         float x2, float y2, float z2,
+                         GLenum mode) {
+    // The normal of every corner is its position, so all faces share the
+    // same eight vertices.
+    GLuint base = vertices_.size();
+    for (int corner = 0; corner < 8; corner++) {
+        float x = (corner & 1) ? x2 : x1;
+        float y = (corner & 2) ? y2 : y1;
+        float z = (corner & 4) ? z2 : z1;
+        AddVertex(x, y, z, x, y, z);
+    }
+
+    Mesh mesh;
+    mesh.mode = mode;
+    mesh.first = indices_.size();
+    mesh.count = 24;
+    for (int face = 0; face < 6; face++) {
+        for (int i = 0; i < 4; i++)
+            indices_.push_back(base + CUBOID_FACES[face][i]);
+    }
+    return mesh;
+}
+
+Mesh Geometry::AddCircle(float x, float y, float z, float r) {
+    Mesh mesh;
+    mesh.mode = GL_POLYGON;
+    mesh.first = indices_.size();
+    for (float i = 0; i < 360.0f; i += 4.0) {
+        indices_.push_back(AddVertex(x + r * cos(deg2rad(i)),
+                                     y + r * sin(deg2rad(i)), z,
+                                     0, 0, 1));
+    }
+    mesh.count = indices_.size() - mesh.first;
+    return mesh;
+}
+
+Mesh Geometry::AddWireSphere(float r, int slices, int stacks) {
+    // The poles, with the rings of latitude between them. The normal of every
+    // vertex points away from the center.
+    GLuint top = AddVertex(0, 0, r, 0, 0, 1);
+    GLuint ring = vertices_.size();
+    for (int i = 1; i < stacks; i++) {
+        float theta = deg2rad(180.0f * i / stacks);
+        for (int j = 0; j < slices; j++) {
+            float phi = deg2rad(360.0f * j / slices);
+            float x = sinf(theta) * cosf(phi),
+                  y = sinf(theta) * sinf(phi),
+                  z = cosf(theta);
+            AddVertex(r * x, r * y, r * z, x, y, z);
+        }
+    }
+    GLuint bottom = AddVertex(0, 0, -r, 0, 0, -1);
+
+    Mesh mesh;
+    mesh.mode = GL_LINES;
+    mesh.first = indices_.size();
+
+    // Lines of longitude, from pole to pole.
+    for (int j = 0; j < slices; j++) {
+        GLuint last = top;
+        for (int i = 0; i < stacks - 1; i++) {
+            GLuint next = ring + i * slices + j;
+            indices_.push_back(last);
+            indices_.push_back(next);
+            last = next;
+        }
+        indices_.push_back(last);
+        indices_.push_back(bottom);
+    }
+
+    // Rings of latitude.
+    for (int i = 0; i < stacks - 1; i++) {
+        for (int j = 0; j < slices; j++) {
+            indices_.push_back(ring + i * slices + j);
+            indices_.push_back(ring + i * slices + (j + 1) % slices);
+        }
+    }
+
+    mesh.count = indices_.size() - mesh.first;
+    return mesh;
+}
+
+int Geometry::size() const {
+    return vertices_.size();
+}
+
+void Geometry::Bind() const {
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    if (vertices_.empty())
+        return;
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glVertexPointer(3, GL_FLOAT, sizeof(Vertex), vertices_[0].position);
+    glNormalPointer(GL_FLOAT, sizeof(Vertex), vertices_[0].normal);
+}
+
+void Geometry::Unbind() const {
+    glPopClientAttrib();
+}
+
+void Geometry::Draw(const Mesh &mesh) const {
+    glDrawElements(mesh.mode, mesh.count, GL_UNSIGNED_INT,
+                   &indices_[mesh.first]);
+}
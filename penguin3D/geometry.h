@@ -0,0 +1,69 @@
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include <vector>
+#include "gl.h"
+
+// A vertex as stored in a Geometry. Position and normal are interleaved so
+// that a part is read from one contiguous run of memory.
+struct Vertex {
+    float position[3];
+    float normal[3];
+};
+
+// A part of a Geometry: a range of its indices drawn as one primitive.
+struct Mesh {
+    GLenum mode;
+    int first;
+    int count;
+};
+
+// A Geometry packs the static shapes of a rig into one vertex array and one
+// index array. Shapes are built once when they are added; drawing one is a
+// single @glDrawElements@ call with no per-vertex work on the CPU.
+//
+// Drawing uses client-side vertex arrays, which only need OpenGL 1.1.
+class Geometry {
+    public:
+        Geometry();
+
+        // Removes all shapes. Capacity is kept.
+        void Clear();
+
+        // Adds a cuboid with opposite corners @(x1, y1, z1)@ and
+        // @(x2, y2, z2)@, made of primitives of the given mode. It looks
+        // exactly like drawCuboid.
+        Mesh AddCuboid(float x1, float y1, float z1,
+                       float x2, float y2, float z2,
+                       GLenum mode);
+
+        // Adds a filled circle of radius @r@ around @(x, y, z)@, parallel to
+        // the XY plane.
+        Mesh AddCircle(float x, float y, float z, float r);
+
+        // Adds the lines of a wire frame sphere of radius @r@ around the
+        // origin, made of @slices@ lines of longitude and @stacks@ bands of
+        // latitude between the poles on the Z axis, like @glutWireSphere@.
+        Mesh AddWireSphere(float r, int slices, int stacks);
+
+        // Number of vertices of all shapes.
+        int size() const;
+
+        // Sets up the vertex arrays to draw from this geometry. The client
+        // vertex array state is saved and has to be restored with @Unbind@.
+        void Bind() const;
+        void Unbind() const;
+
+        // Draws the given part. The geometry must be bound.
+        void Draw(const Mesh &mesh) const;
+
+    private:
+        // Adds a vertex and returns its index.
+        GLuint AddVertex(float x, float y, float z,
+                         float nx, float ny, float nz);
+
+        std::vector<Vertex> vertices_;
+        std::vector<GLuint> indices_;
+};
+
+#endif /* end of include guard: GEOMETRY_H */
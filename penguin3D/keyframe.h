@@ -9,7 +9,8 @@
                         represents a keyframe: (t_i, q_i)
                         where t_i is the time and
                               q_i is the pose vector at that time
-                        (see vector.h file for info on Vector class).
+                        (see fixedvector.h file for info on the
+                        FixedVector class).
                         The data structure also includes an ID to
                         identify the keyframe.
 
@@ -18,14 +19,10 @@
 #ifndef __KEYFRAME_H__
 #define __KEYFRAME_H__
 
-#include "vector.h"
+#include "fixedvector.h"
 
 class Keyframe 
 {
-private:
-    int id;
-    float time;
-    Vector jointDOFS;
 public:
 
     // Enumeration describing the supported joint DOFs.
@@ -45,9 +42,19 @@ public:
         NUM_JOINT_ENUM
     };
 
+    // The pose vector, one value per joint DOF. It is stored inline, so
+    // keyframes and poses can be copied and interpolated without allocating.
+    typedef FixedVector<NUM_JOINT_ENUM> Pose;
+
+private:
+    int id;
+    float time;
+    Pose jointDOFS;
+public:
+
     // constructor
 
-    Keyframe() : id(0), time(0.0), jointDOFS(NUM_JOINT_ENUM) {
+    Keyframe() : id(0), time(0.0), jointDOFS() {
         setDOF(L_ELBOW_SCALE, 1.0);
         setDOF(R_ELBOW_SCALE, 1.0);
     }
@@ -87,13 +94,13 @@ public:
 
     // These allow the entire pose vector to be obtained / set.
     // Useful when calculating interpolated poses.
-    // (see vector.h file for info on Vector class)
+    // (see fixedvector.h file for info on FixedVector class)
 
-    Vector getDOFVector() const {
+    const Pose& getDOFVector() const {
         return jointDOFS;
     }
 
-    void setDOFVector(const Vector& vec) {
+    void setDOFVector(const Pose& vec) {
         jointDOFS = vec;
     }
 
@@ -107,6 +114,10 @@ public:
         return &time;
     }
 
+    const float* getTimePtr() const {
+        return &time;
+    }
+
     float* getDOFPtr(int eDOF) {
         return &jointDOFS[eDOF];
     }
@@ -0,0 +1,195 @@
+#include "keyframefile.h"
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char MAGIC[4] = { 'P', 'K', 'F', 0 };
+
+// Returns @offset@ rounded up to the alignment of the sections.
+static uint64_t alignSection(uint64_t offset) {
+    uint64_t mask = KEYFRAME_FILE_ALIGNMENT - 1;
+    return (offset + mask) & ~mask;
+}
+
+// Returns true if a section of @bytes@ bytes at @offset@ lies inside a file
+// of @length@ bytes, after the header.
+static bool validSection(uint64_t offset, uint64_t bytes, uint64_t length) {
+    return offset % KEYFRAME_FILE_ALIGNMENT == 0 &&
+           offset >= sizeof(KeyframeFileHeader) && offset <= length &&
+           bytes <= length - offset;
+}
+
+// Returns true if @length@ bytes at @data@ are a keyframe file that can be
+// used in place.
+static bool validKeyframeFile(const char *data, size_t length) {
+    if (length < sizeof(KeyframeFileHeader))
+        return false;
+
+    const KeyframeFileHeader *header =
+        reinterpret_cast<const KeyframeFileHeader *>(data);
+    if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        header->version != KEYFRAME_FILE_VERSION ||
+        header->byteOrder != KEYFRAME_FILE_BYTE_ORDER ||
+        header->channels != Keyframe::NUM_JOINT_ENUM ||
+        header->keyframes > INT_MAX)
+        return false;
+
+    // None of these can overflow, given the limits checked above.
+    uint64_t channels = header->channels;
+    uint64_t keyframes = header->keyframes;
+    if (!validSection(header->channelOffset, channels * sizeof(uint32_t), length) ||
+        !validSection(header->timeOffset, keyframes * sizeof(float), length) ||
+        !validSection(header->poseOffset,
+                      keyframes * channels * sizeof(float), length))
+        return false;
+
+    const uint32_t *table =
+        reinterpret_cast<const uint32_t *>(data + header->channelOffset);
+    for (uint32_t i = 0; i < channels; i++) {
+        if (table[i] != i)
+            return false;
+    }
+
+    // Comparisons with NaN are false, so NaN times are rejected too.
+    const float *times = reinterpret_cast<const float *>(data + header->timeOffset);
+    for (uint64_t i = 0; i < keyframes; i++) {
+        if (times[i] != times[i] || (i > 0 && !(times[i - 1] <= times[i])))
+            return false;
+    }
+    return true;
+}
+
+KeyframeFile::KeyframeFile() {
+    data_ = 0;
+    length_ = 0;
+    size_ = 0;
+    times_ = 0;
+    poses_ = 0;
+}
+
+KeyframeFile::~KeyframeFile() {
+    Close();
+}
+
+bool KeyframeFile::Open(const char *filename) {
+    Close();
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat status;
+    void *data = MAP_FAILED;
+    size_t length = 0;
+    if (fstat(fd, &status) == 0 && status.st_size > 0) {
+        length = status.st_size;
+        data = mmap(0, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+
+    // The mapping stays valid after the file is closed.
+    close(fd);
+    if (data == MAP_FAILED)
+        return false;
+
+    if (!validKeyframeFile(static_cast<const char *>(data), length)) {
+        munmap(data, length);
+        return false;
+    }
+
+    const char *bytes = static_cast<const char *>(data);
+    const KeyframeFileHeader *header =
+        reinterpret_cast<const KeyframeFileHeader *>(bytes);
+    data_ = data;
+    length_ = length;
+    size_ = header->keyframes;
+    times_ = reinterpret_cast<const float *>(bytes + header->timeOffset);
+    poses_ = reinterpret_cast<const float *>(bytes + header->poseOffset);
+    return true;
+}
+
+void KeyframeFile::Close() {
+    if (data_ != 0)
+        munmap(data_, length_);
+    data_ = 0;
+    length_ = 0;
+    size_ = 0;
+    times_ = 0;
+    poses_ = 0;
+}
+
+bool KeyframeFile::isOpen() const {
+    return data_ != 0;
+}
+
+int KeyframeFile::size() const {
+    return size_;
+}
+
+const float *KeyframeFile::times() const {
+    return times_;
+}
+
+const float *KeyframeFile::poses() const {
+    return poses_;
+}
+
+bool isKeyframeFile(const char *filename) {
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL)
+        return false;
+
+    char magic[sizeof(MAGIC)];
+    bool matches = fread(magic, sizeof(magic), 1, file) == 1 &&
+                   memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+    fclose(file);
+    return matches;
+}
+
+// Writes zeros up to @offset@, which must not be before the current position.
+static void padTo(FILE *file, uint64_t offset) {
+    while (uint64_t(ftell(file)) < offset)
+        fputc(0, file);
+}
+
+bool writeKeyframeFile(const char *filename, const TrackView &track) {
+    const int dofs = Keyframe::NUM_JOINT_ENUM;
+    int count = track.last() + 1;
+
+    KeyframeFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = KEYFRAME_FILE_VERSION;
+    header.byteOrder = KEYFRAME_FILE_BYTE_ORDER;
+    header.channels = dofs;
+    header.keyframes = count;
+    header.channelOffset = alignSection(sizeof(header));
+    header.timeOffset = alignSection(header.channelOffset + dofs * sizeof(uint32_t));
+    header.poseOffset = alignSection(header.timeOffset + count * sizeof(float));
+
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL)
+        return false;
+
+    fwrite(&header, sizeof(header), 1, file);
+
+    padTo(file, header.channelOffset);
+    for (uint32_t i = 0; i < uint32_t(dofs); i++)
+        fwrite(&i, sizeof(i), 1, file);
+
+    padTo(file, header.timeOffset);
+    for (int i = 0; i < count; i++) {
+        float time = track.time(i);
+        fwrite(&time, sizeof(time), 1, file);
+    }
+
+    padTo(file, header.poseOffset);
+    for (int i = 0; i < count; i++)
+        fwrite(track.pose(i), sizeof(float), dofs, file);
+
+    bool ok = !ferror(file);
+    return fclose(file) == 0 && ok;
+}
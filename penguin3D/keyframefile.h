@@ -0,0 +1,90 @@
+#ifndef KEYFRAMEFILE_H
+#define KEYFRAMEFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "animation.h"
+
+// Keyframe files store a track of keyframes in binary, in the layout it is
+// sampled in, so that a file can be mapped into memory and used in place
+// without parsing or copying anything:
+//
+//    header          a KeyframeFileHeader
+//    channel table   one uint32_t per channel: the Keyframe DOF it holds,
+//                    e.g. Keyframe::HEAD_YAW
+//    times           one float per keyframe, non-decreasing
+//    poses           one float per channel per keyframe, keyframe after
+//                    keyframe
+//
+// Every section starts at a multiple of KEYFRAME_FILE_ALIGNMENT bytes. Values
+// are stored in the byte order of the machine that wrote the file; files in
+// the other order are rejected rather than converted. Keyframe IDs are not
+// stored, since they are the indices of the keyframes.
+enum {
+    KEYFRAME_FILE_VERSION = 1,
+    KEYFRAME_FILE_ALIGNMENT = 16,
+    KEYFRAME_FILE_BYTE_ORDER = 0x01020304
+};
+
+struct KeyframeFileHeader {
+    char magic[4];              // "PKF" and a zero byte
+    uint32_t version;           // KEYFRAME_FILE_VERSION
+    uint32_t byteOrder;         // KEYFRAME_FILE_BYTE_ORDER
+    uint32_t channels;          // number of channels (DOFs) per keyframe
+    uint64_t keyframes;         // number of keyframes
+
+    // Where the sections start, in bytes from the start of the file.
+    uint64_t channelOffset;
+    uint64_t timeOffset;
+    uint64_t poseOffset;
+};
+
+// A KeyframeFile maps a keyframe file into memory, read-only.
+//
+// Only files with a channel for every Keyframe DOF, in order, can be mapped,
+// since only their poses can be sampled as they are. writeKeyframeFile always
+// writes such files. The file must not be changed while it is mapped, since
+// its contents are read as they are on disk.
+class KeyframeFile {
+    public:
+        KeyframeFile();
+        ~KeyframeFile();
+
+        // Maps the given file. Returns false, leaving the file closed, if it
+        // cannot be mapped or is not a valid keyframe file: every field of
+        // the header is checked, every section must be inside the file, and
+        // the times must be non-decreasing.
+        bool Open(const char *filename);
+
+        // Unmaps the file.
+        void Close();
+
+        bool isOpen() const;
+
+        // Number of keyframes.
+        int size() const;
+
+        // The packed times and poses of the keyframes, as taken by TrackView.
+        const float *times() const;
+        const float *poses() const;
+
+    private:
+        KeyframeFile(const KeyframeFile &);
+        KeyframeFile &operator =(const KeyframeFile &);
+
+        void *data_;
+        size_t length_;
+        int size_;
+        const float *times_;
+        const float *poses_;
+};
+
+// Returns true if the given file starts like a keyframe file, rather than a
+// text keyframe list.
+bool isKeyframeFile(const char *filename);
+
+// Writes the track to the given keyframe file. Returns false if the file
+// cannot be written.
+bool writeKeyframeFile(const char *filename, const TrackView &track);
+
+#endif /* end of include guard: KEYFRAMEFILE_H */
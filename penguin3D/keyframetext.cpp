@@ -0,0 +1,519 @@
+#include "keyframetext.h"
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Powers of ten that are exact doubles.
+static const double POW10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+static const int MAX_POW10 = 22;
+
+// Digits that fit in a uint64_t whatever they are.
+static const int MAX_DIGITS = 19;
+
+// Converts @mantissa@ / 10^@decimals@ to the nearest float, the way strtof
+// would. Returns false if that cannot be done quickly, e.g. for very small
+// values; use strtof then.
+static bool decimalToFloat(uint64_t mantissa, int decimals, bool negative,
+                           float *value) {
+    if (mantissa >= (uint64_t(1) << 53) || decimals > MAX_POW10)
+        return false;
+
+    // Both operands are exact, so the quotient is the double nearest the
+    // decimal. Rounding that to a float gives the float nearest the decimal
+    // too, unless the double fell exactly halfway between two floats.
+    double quotient = double(mantissa) / POW10[decimals];
+    if (quotient != 0 && quotient < FLT_MIN)
+        return false;
+    uint64_t bits;
+    memcpy(&bits, &quotient, sizeof(bits));
+    if ((bits & 0x1fffffff) == 0x10000000)
+        return false;
+
+    *value = float(negative ? -quotient : quotient);
+    return true;
+}
+
+// Bytes readable past the end of the text, so that digits can be scanned
+// eight at a time, from up to eight bytes past the last value.
+static const int TEXT_PADDING = 16;
+
+// Powers of ten up to 10^8, for adding up eight digits at a time.
+static const uint64_t SCALE[] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000
+};
+
+// Loads the eight bytes at @p@ as one little-endian word, with '0' to '9'
+// turned into 0 to 9.
+static inline uint64_t loadDigits(const char *p) {
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    return word ^ (0x0101010101010101ull * '0');
+}
+
+// Returns the number of digits loadDigits found before anything else, up to
+// eight.
+static inline int countDigits(uint64_t bytes) {
+    // Digits are 0 to 9 and everything else 10 or more, whose bytes get their
+    // top bit set by the addition (or have it already).
+    const uint64_t ones = 0x0101010101010101ull;
+    uint64_t others = ((bytes + ones * 0x76) | bytes) & (ones * 0x80);
+    return others ? __builtin_ctzll(others) / 8 : 8;
+}
+
+// Returns the number the first @count@ digits loadDigits found make up, for a
+// @count@ of 1 to 8.
+static inline uint64_t digitsValue(uint64_t bytes, int count) {
+    // Shift the digits to the top, leaving zeros (leading zeros of the
+    // number) below them, and add them up pairwise.
+    uint64_t v = bytes << (8 * (8 - count));
+    v = v * 10 + (v >> 8);
+    return (((v & 0x000000ff000000ffull) * 0x000f424000000064ull) +
+            (((v >> 16) & 0x000000ff000000ffull) * 0x0000271000000001ull)) >> 32;
+}
+
+// Adds the digits at @p@ to @*value@, as in @*value * 10 + digit@, and
+// returns the number of digits. @p@ must be followed by a non-digit within
+// the text or its padding.
+//
+// The digits are scanned eight at a time as one little-endian word, which is
+// several times faster than one at a time for the 8 to 10 digits of a
+// typical DOF.
+static inline int scanDigits(const char *p, uint64_t *value) {
+    int count = 0;
+    for (;;) {
+        uint64_t bytes = loadDigits(p + count);
+        int digits = countDigits(bytes);
+        if (digits == 0)
+            return count;
+
+        *value = *value * SCALE[digits] + digitsValue(bytes, digits);
+        count += digits;
+        if (digits < 8)
+            return count;
+    }
+}
+
+static inline bool isSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' ||
+           c == '\f';
+}
+
+static inline bool isDigit(char c) {
+    return unsigned(c - '0') < 10;
+}
+
+// Returns true if the value ending at @p@ is followed by whitespace or the
+// end of the text.
+static inline bool atSeparator(const char *p, const char *end) {
+    return p == end || isSpace(*p);
+}
+
+// Parses the number at @p@ into @*value@. Returns where it ends, or null if
+// it is not a finite float followed by whitespace or the end of the text.
+static const char *parseAnyFloat(const char *p, const char *end,
+                                 float *value) {
+    // Decimals like those printf's %f writes, e.g. -12.345678, are converted
+    // here. Anything else, e.g. exponents or too many digits, goes to strtof.
+    // The digits are summed up even if there are too many, since the sum is
+    // not used then.
+    const char *start = p;
+    bool negative = *p == '-';
+    p += negative | (*p == '+');
+
+    uint64_t mantissa = 0;
+    int digits = scanDigits(p, &mantissa);
+    p += digits;
+
+    int decimals = 0;
+    if (*p == '.') {
+        decimals = scanDigits(++p, &mantissa);
+        p += decimals;
+        digits += decimals;
+    }
+
+    if (digits == 0 || digits > MAX_DIGITS || !atSeparator(p, end) ||
+        !decimalToFloat(mantissa, decimals, negative, value)) {
+        char *stop;
+        *value = strtof(start, &stop);
+        p = stop;
+        if (stop == start || !atSeparator(p, end))
+            return 0;
+    }
+    return isfinite(*value) ? p : 0;
+}
+
+// Parses the number at @p@ as parseAnyFloat does.
+//
+// Decimals with one to eight digits on either side of the point, e.g.
+// -12.345678 and nearly everything the writer writes, are converted without
+// a branch on the number of digits, which is the same from one value to the
+// next too rarely to predict.
+static inline const char *parseFloat(const char *p, const char *end,
+                                     float *value) {
+    const char *start = p;
+    bool negative = *p == '-';
+    p += negative;
+
+    uint64_t whole = loadDigits(p);
+    int wholeDigits = countDigits(whole);
+    uint64_t fraction = loadDigits(p + wholeDigits + 1);
+    int decimals = countDigits(fraction);
+    const char *stop = p + wholeDigits + 1 + decimals;
+    if (wholeDigits - 1u < 8u && decimals - 1u < 8u && p[wholeDigits] == '.' &&
+        atSeparator(stop, end)) {
+        uint64_t mantissa = digitsValue(whole, wholeDigits) * SCALE[decimals] +
+                            digitsValue(fraction, decimals);
+        if (decimalToFloat(mantissa, decimals, negative, value))
+            return stop;
+    }
+    return parseAnyFloat(start, end, value);
+}
+
+// Parses a text keyframe list from memory, keeping track of the line. The
+// text must be followed by TEXT_PADDING NULs.
+class TextReader {
+    public:
+        TextReader(const char *begin, const char *end)
+            : p_(begin), end_(end), line_(1) { }
+
+        // Skips whitespace and returns false at the end of the text.
+        bool More() {
+            for (; p_ < end_; p_++) {
+                if (*p_ == '\n')
+                    line_++;
+                else if (!isSpace(*p_))
+                    return true;
+            }
+            return false;
+        }
+
+        // Reads the next value, which must be followed by whitespace or the
+        // end of the text.
+        bool ReadInt(int *value);
+
+        // Reads the next @count@ values, like ReadInt. On failure, the line
+        // is the one of the value that could not be read.
+        bool ReadFloats(float *values, int count);
+
+        int line() const { return line_; }
+
+    private:
+        const char *p_;
+        const char *end_;
+        int line_;
+};
+
+bool TextReader::ReadInt(int *value) {
+    if (!More())
+        return false;
+
+    bool negative = *p_ == '-';
+    if (*p_ == '-' || *p_ == '+')
+        p_++;
+    if (!isDigit(*p_))
+        return false;
+
+    int64_t result = 0;
+    for (; isDigit(*p_); p_++) {
+        result = result * 10 + (*p_ - '0');
+        if (result > int64_t(INT_MAX) + 1)
+            return false;
+    }
+    if (negative)
+        result = -result;
+    if (result > INT_MAX || !atSeparator(p_, end_))
+        return false;
+
+    *value = int(result);
+    return true;
+}
+
+bool TextReader::ReadFloats(float *values, int count) {
+    // The position and line are kept in registers rather than in members
+    // while the values are read.
+    const char *p = p_;
+    int line = line_;
+    bool ok = true;
+    for (int i = 0; ok && i < count; i++) {
+        // Values are usually one per line, so try a single newline first.
+        if (*p == '\n' && !isSpace(p[1])) {
+            p++;
+            line++;
+        }
+        for (; p < end_ && isSpace(*p); p++)
+            line += *p == '\n';
+
+        const char *next = p < end_ ? parseFloat(p, end_, values + i) : 0;
+        ok = next != 0;
+        if (ok)
+            p = next;
+    }
+    p_ = p;
+    line_ = line;
+    return ok;
+}
+
+// The whole file is read once, front to back, so where the system can, map
+// all of it up front rather than faulting it in a page at a time.
+#ifdef MAP_POPULATE
+static const int POPULATE = MAP_POPULATE;
+#else
+static const int POPULATE = 0;
+#endif
+
+// A text file mapped into memory, followed by at least TEXT_PADDING NULs.
+class MappedText {
+    public:
+        MappedText() : data_(0), size_(0), length_(0) { }
+        ~MappedText() {
+            if (data_ != 0)
+                munmap(data_, length_);
+        }
+
+        // Maps the given file. Returns false if it cannot be mapped.
+        //
+        // Mapping avoids copying the file out of the page cache. The file is
+        // mapped over anonymous zero pages that extend at least
+        // TEXT_PADDING bytes past its end (the rest of its last page reads
+        // as zeros too), so that the padding is there whatever its size.
+        bool Map(const char *filename) {
+            int fd = open(filename, O_RDONLY);
+            if (fd < 0)
+                return false;
+
+            struct stat status;
+            bool ok = fstat(fd, &status) == 0;
+            if (ok) {
+                size_t page = sysconf(_SC_PAGESIZE);
+                size_ = status.st_size;
+                length_ = (size_ + TEXT_PADDING + page - 1) / page * page;
+                void *data = mmap(0, length_, PROT_READ,
+                                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                ok = data != MAP_FAILED;
+                if (ok)
+                    data_ = data;
+                if (ok && size_ > 0) {
+                    ok = mmap(data, size_, PROT_READ,
+                              MAP_PRIVATE | MAP_FIXED | POPULATE, fd,
+                              0) != MAP_FAILED;
+                }
+            }
+            close(fd);
+            return ok;
+        }
+
+        const char *data() const { return static_cast<const char *>(data_); }
+        size_t size() const { return size_; }
+
+    private:
+        MappedText(const MappedText &);
+        MappedText &operator =(const MappedText &);
+
+        void *data_;
+        size_t size_;
+        size_t length_;
+};
+
+// Records the given problem in @error@, if there is one, and returns false.
+static bool fail(KeyframeTextError *error, int line, const char *message) {
+    if (error) {
+        error->line = line;
+        error->message = message;
+    }
+    return false;
+}
+
+// Parses the text keyframe list of @size@ bytes at @text@, as
+// readKeyframeText does.
+static bool parseKeyframeText(const char *text, size_t size,
+                              KeyframeTrack &track, KeyframeTextError *error) {
+    TextReader reader(text, text + size);
+    // A track holds at most INT_MAX keyframes, so the index of the last one
+    // is below INT_MAX, and counting the keyframes cannot overflow.
+    int last;
+    if (!reader.ReadInt(&last) || last < -1 || last >= INT_MAX)
+        return fail(error, reader.line(), "expected the index of the last keyframe");
+
+    // Every keyframe takes at least two characters per value, which bounds
+    // the room worth reserving whatever the index says.
+    const int values = Keyframe::NUM_JOINT_ENUM + 2;
+    size_t fits = size / (2 * values);
+    size_t count = size_t(last) + 1;
+    track.Reserve(count < fits ? int(count) : int(fits));
+
+    Keyframe keyframe;
+    for (int i = 0; i <= last; i++) {
+        if (!reader.ReadInt(keyframe.getIDPtr()))
+            return fail(error, reader.line(), "expected a keyframe ID");
+        if (!reader.ReadFloats(keyframe.getTimePtr(), 1))
+            return fail(error, reader.line(), "expected a keyframe time");
+        if (!reader.ReadFloats(keyframe.getDOFPtr(0), Keyframe::NUM_JOINT_ENUM))
+            return fail(error, reader.line(), "expected a DOF value");
+        track.Append(keyframe);
+    }
+
+    if (reader.More())
+        return fail(error, reader.line(), "unexpected text after the last keyframe");
+    track.Sort();
+    return true;
+}
+
+bool readKeyframeText(const char *filename, KeyframeTrack &track,
+                      KeyframeTextError *error) {
+    MappedText text;
+    if (!text.Map(filename))
+        return fail(error, 0, "cannot read the file");
+    return parseKeyframeText(text.data(), text.size(), track, error);
+}
+
+// Buffers text and writes it to a file in large blocks.
+class TextWriter {
+    public:
+        TextWriter(FILE *file) : file_(file), used_(0) { }
+        ~TextWriter() { Flush(); }
+
+        void WriteInt(int value) {
+            Reserve();
+            used_ += sprintf(buffer_ + used_, "%d\n", value);
+        }
+
+        void WriteFloat(float value);
+
+        void WriteLine() {
+            Reserve();
+            buffer_[used_++] = '\n';
+        }
+
+        void Flush() {
+            fwrite(buffer_, 1, used_, file_);
+            used_ = 0;
+        }
+
+    private:
+        // Longest line a value can take.
+        enum { MAX_LINE = 32, SIZE = 64 * 1024 };
+
+        // Makes room for a line.
+        void Reserve() {
+            if (used_ + MAX_LINE > SIZE)
+                Flush();
+        }
+
+        FILE *file_;
+        char buffer_[SIZE];
+        int used_;
+};
+
+// Returns true if @mantissa@ / 10^@decimals@, the nearest decimal to @value@
+// with that many decimals, reads back as @value@. Writes the mantissa.
+static bool roundTrips(float value, int decimals, uint64_t *mantissa) {
+    double scaled = fabs(double(value)) * POW10[decimals] + 0.5;
+    if (scaled >= double(uint64_t(1) << 53))
+        return false;
+
+    float parsed;
+    *mantissa = uint64_t(scaled);
+    return decimalToFloat(*mantissa, decimals, signbit(value), &parsed) &&
+           memcmp(&parsed, &value, sizeof(value)) == 0;
+}
+
+void TextWriter::WriteFloat(float value) {
+    Reserve();
+    char *out = buffer_ + used_;
+
+    // Find the fewest decimals that read back as the same float. If some
+    // number of decimals does, so do more, so start from a guess of about
+    // eight significant digits and step down or up from there.
+    const int MAX_DECIMALS = 9;
+    double magnitude = fabs(double(value));
+    int integerDigits = 0;
+    while (integerDigits <= MAX_POW10 && magnitude >= POW10[integerDigits])
+        integerDigits++;
+    int decimals = 8 - integerDigits;
+    decimals = decimals < 0 ? 0 : decimals;
+
+    uint64_t mantissa;
+    if (roundTrips(value, decimals, &mantissa)) {
+        uint64_t shorter;
+        while (decimals > 0 && roundTrips(value, decimals - 1, &shorter)) {
+            decimals--;
+            mantissa = shorter;
+        }
+    } else {
+        do {
+            decimals++;
+        } while (decimals <= MAX_DECIMALS &&
+                 !roundTrips(value, decimals, &mantissa));
+    }
+
+    // Nine significant digits always read back the same.
+    if (decimals > MAX_DECIMALS) {
+        used_ += sprintf(out, "%.9g\n", value);
+        return;
+    }
+
+    // Write the digits backwards, with the point @decimals@ from the end and
+    // at least one digit before it.
+    char digits[24];
+    int length = 0;
+    do {
+        if (length == decimals && decimals > 0)
+            digits[length++] = '.';
+        digits[length++] = '0' + mantissa % 10;
+        mantissa /= 10;
+    } while (mantissa != 0 || length <= decimals);
+
+    if (signbit(value))
+        *out++ = '-';
+    while (length > 0)
+        *out++ = digits[--length];
+    *out++ = '\n';
+    used_ = out - buffer_;
+}
+
+bool writeKeyframeText(const char *filename, const TrackView &track) {
+    FILE *file = fopen(filename, "w");
+    if (file == NULL)
+        return false;
+
+    {
+        TextWriter writer(file);
+
+        // Write out the index of the last keyframe first
+        writer.WriteInt(track.last());
+        writer.WriteLine();
+
+        // Now write out all keyframes in the format:
+        //    id
+        //    time
+        //    DOFs
+        //
+        for (int i = 0; i <= track.last(); i++) {
+            writer.WriteInt(i);
+            writer.WriteFloat(track.time(i));
+
+            const float *pose = track.pose(i);
+            for (int j = 0; j < Keyframe::NUM_JOINT_ENUM; j++)
+                writer.WriteFloat(pose[j]);
+
+            writer.WriteLine();
+        }
+    }
+
+    bool ok = !ferror(file);
+    return fclose(file) == 0 && ok;
+}
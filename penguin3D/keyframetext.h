@@ -0,0 +1,41 @@
+#ifndef KEYFRAMETEXT_H
+#define KEYFRAMETEXT_H
+
+#include "animation.h"
+
+// Text keyframe lists store the index of the last keyframe, then for every
+// keyframe its ID, its time and its Keyframe::NUM_JOINT_ENUM DOFs, one value
+// per line:
+//
+//    1
+//
+//    0
+//    0.5
+//    12.25
+//    ...
+//
+// Values can be separated by any whitespace. The reader parses the whole
+// file from memory rather than a value at a time, and the writer prints the
+// shortest decimals that read back as the same float, so that saving and
+// loading a track does not change it.
+
+// Where and why a text keyframe list could not be read. Line 0 stands for the
+// whole file, e.g. if it could not be opened.
+struct KeyframeTextError {
+    int line;
+    const char *message;
+};
+
+// Reads the given text keyframe list into the given empty track, sorted by
+// time. Returns false if the file cannot be read or is not a valid list, and
+// describes the first problem in @error@ if one is given; the track may then
+// hold some of the keyframes. The file is mapped into memory while it is
+// read, so it must not be changed meanwhile.
+bool readKeyframeText(const char *filename, KeyframeTrack &track,
+                      KeyframeTextError *error = 0);
+
+// Writes the track to the given file as a text keyframe list. Returns false
+// if the file cannot be written.
+bool writeKeyframeText(const char *filename, const TrackView &track);
+
+#endif /* end of include guard: KEYFRAMETEXT_H */
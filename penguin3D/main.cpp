@@ -0,0 +1,127 @@
+#include "penguin.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Default settings of the --compress option: largest error of angles, in
+// degrees, and of other DOFs, and bits per value.
+const float COMPRESS_ANGULAR_ERROR = 0.1;
+const float COMPRESS_POSITIONAL_ERROR = 0.01;
+const int COMPRESS_BITS = 16;
+
+//--------------------------------------------------------
+// main() function
+//--------------------------------------------------------
+// Initializes the user interface (and any user variables)
+// then hands over control to the event handler, which calls 
+// display() whenever the GL window needs to be redrawn.
+int main(int argc, char** argv)
+{
+
+    // Crowd options come before the window size:
+    //    penguin --crowd N [width] [height]  draws a crowd of N penguins
+    //    penguin --convert FROM TO           converts a text keyframe list
+    //                                        to a keyframe file, or a
+    //                                        keyframe file to a text list
+    //    penguin --compress FILE [ANGULAR POSITIONAL [BITS]]
+    //                                        compresses a keyframe list with
+    //                                        the given largest errors and
+    //                                        12 or 16 bits per value, and
+    //                                        reports its size and error
+    //
+    // The benchmarks and checks are programs of their own, penguin_bench and
+    // penguin_check (see bench.cpp and check.cpp).
+    if (argc >= 4 && strcmp(argv[1], "--convert") == 0)
+        return convertKeyframes(argv[2], argv[3]);
+    if (argc >= 3 && strcmp(argv[1], "--compress") == 0) {
+        CompressionSettings settings = { COMPRESS_ANGULAR_ERROR,
+                                         COMPRESS_POSITIONAL_ERROR,
+                                         COMPRESS_BITS };
+        if (argc >= 5) {
+            settings.angularError = atof(argv[3]);
+            settings.positionalError = atof(argv[4]);
+        }
+        if (argc >= 6)
+            settings.bits = atoi(argv[5]);
+        return compressKeyframes(argv[2], settings);
+    }
+    if (argc >= 3 && strcmp(argv[1], "--crowd") == 0) {
+        crowdSize = atoi(argv[2]);
+
+        // Drop the option, keeping the program name.
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+    }
+
+    // Process program arguments
+    if(argc != 3) {
+        printf("Usage: demo [--crowd N] [width] [height]\n");
+        printf("       demo --convert FROM TO\n");
+        printf("       demo --compress FILE [ANGULAR POSITIONAL [BITS]]\n");
+        printf("Using 640x480 window by default...\n");
+        Win[0] = 640; // width 
+        Win[1] = 480; // height 
+    } else {
+        Win[0] = atoi(argv[1]); // window width
+        Win[1] = atoi(argv[2]); // window height 
+    }
+
+
+
+    // Initialize data structs, glut, glui, and opengl
+  //  initDS(); // Initialize key frames
+  //  initGlut(argc, argv); // Initialize Glut
+  //  initGlui(); // Set up user interface 
+  //  initGl(); // Initialize openGL 
+
+    // Initialize GLUT
+    glutInit(&argc, argv);
+    glutInitDisplayMode(GLUT_DOUBLE|GLUT_RGB|GLUT_DEPTH);
+    glutInitWindowPosition(0, 0);
+    glutInitWindowSize(Win[0], Win[1]);
+    windowID = glutCreateWindow(argv[0]);
+
+    // Set up callbacks
+    glutReshapeFunc(reshape);
+    glutDisplayFunc(display);
+    glutMouseFunc(mouse);
+    glutMotionFunc(motion);
+ 
+    initGlui(); // Set up UI
+
+//----------------------------------------------------------------------------------------------------------------------------------------------------------------
+// DRAW THE PENGUIN HERE
+//----------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+    buildPenguin();
+
+    if (crowdSize > 0) {
+        KeyframeTextError error;
+        if (!loadKeyframes(filenameKF, &error)) {
+            formatLoadError(msg, filenameKF, error);
+            printf("%s, the crowd will stand still\n", msg);
+        }
+        crowd = new Crowd(pipelineCommands, Keyframe::NUM_JOINT_ENUM,
+                          interpolatePoses, keyframes.duration());
+        crowd->Populate(crowdSize, CROWD_SPACING);
+    }
+
+//----------------------------------------------------------------------------------------------------------------------------------------------------------------
+//Finish Drawing the Penguin and connecting all connections 
+//----------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+    // Set up OpenGL
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_NORMALIZE);
+    glClearColor(0.7f, 0.7f, 0.9f, 1.0f);
+
+    // GLUT leaves its event loop by calling exit(); stop the animation thread
+    // then, before what it reads is destroyed
+    atexit([]{ stopAnimationThread(); });
+
+    // Invoke the standard GLUT main event loop
+    glutMainLoop();
+
+    return 0;         // never reached
+}
@@ -0,0 +1,141 @@
+#include "matrix.h"
+#include <assert.h>
+#include <math.h>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+inline float deg2rad(float deg) { return deg * M_PI / 180; }
+
+//////////////////////////////////////////////////////////////////////////////
+// Column helpers
+//////////////////////////////////////////////////////////////////////////////
+
+// Replaces the columns @a@ and @b@ with @c * a + s * b@ and @c * b - s * a@.
+// This is all that post-multiplying by a rotation about a coordinate axis
+// changes.
+static inline void rotateColumns(float *a, float *b, float c, float s) {
+#ifdef __SSE__
+    __m128 va = _mm_load_ps(a);
+    __m128 vb = _mm_load_ps(b);
+    __m128 vc = _mm_set1_ps(c);
+    __m128 vs = _mm_set1_ps(s);
+    _mm_store_ps(a, _mm_add_ps(_mm_mul_ps(vc, va), _mm_mul_ps(vs, vb)));
+    _mm_store_ps(b, _mm_sub_ps(_mm_mul_ps(vc, vb), _mm_mul_ps(vs, va)));
+#else
+    for (int i = 0; i < 4; i++) {
+        float ai = a[i], bi = b[i];
+        a[i] = c * ai + s * bi;
+        b[i] = c * bi - s * ai;
+    }
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Matrix
+//////////////////////////////////////////////////////////////////////////////
+
+Matrix Matrix::identity() {
+    Matrix result;
+    for (int i = 0; i < 16; i++)
+        result.m[i] = (i % 5 == 0) ? 1 : 0;
+    return result;
+}
+
+Matrix Matrix::multiply(const Matrix &a, const Matrix &b) {
+    Matrix result;
+#ifdef __SSE__
+    __m128 a0 = _mm_load_ps(a.m);
+    __m128 a1 = _mm_load_ps(a.m + 4);
+    __m128 a2 = _mm_load_ps(a.m + 8);
+    __m128 a3 = _mm_load_ps(a.m + 12);
+
+    // Every column of the result is a combination of the columns of @a@
+    // weighted by the entries of the corresponding column of @b@.
+    for (int j = 0; j < 4; j++) {
+        const float *column = b.m + 4 * j;
+        __m128 r = _mm_mul_ps(a0, _mm_set1_ps(column[0]));
+        r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(column[1])));
+        r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(column[2])));
+        r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_set1_ps(column[3])));
+        _mm_store_ps(result.m + 4 * j, r);
+    }
+#else
+    for (int j = 0; j < 4; j++) {
+        for (int i = 0; i < 4; i++) {
+            float sum = 0;
+            for (int k = 0; k < 4; k++)
+                sum += a.m[4 * k + i] * b.m[4 * j + k];
+            result.m[4 * j + i] = sum;
+        }
+    }
+#endif
+    return result;
+}
+
+void Matrix::translate(float x, float y, float z) {
+#ifdef __SSE__
+    __m128 r = _mm_load_ps(m + 12);
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(m), _mm_set1_ps(x)));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(m + 4), _mm_set1_ps(y)));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(m + 8), _mm_set1_ps(z)));
+    _mm_store_ps(m + 12, r);
+#else
+    for (int i = 0; i < 4; i++)
+        m[12 + i] += m[i] * x + m[4 + i] * y + m[8 + i] * z;
+#endif
+}
+
+void Matrix::scale(float x, float y, float z) {
+    for (int i = 0; i < 4; i++) {
+        m[i] *= x;
+        m[4 + i] *= y;
+        m[8 + i] *= z;
+    }
+}
+
+void Matrix::rotateX(float angle) {
+    float rad = deg2rad(angle);
+    rotateColumns(m + 4, m + 8, cosf(rad), sinf(rad));
+}
+
+void Matrix::rotateY(float angle) {
+    float rad = deg2rad(angle);
+    rotateColumns(m + 8, m, cosf(rad), sinf(rad));
+}
+
+void Matrix::rotateZ(float angle) {
+    float rad = deg2rad(angle);
+    rotateColumns(m, m + 4, cosf(rad), sinf(rad));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// MatrixStack
+//////////////////////////////////////////////////////////////////////////////
+
+MatrixStack::MatrixStack() : stack_(1), top_(0) {
+    Reset(Matrix::identity());
+}
+
+void MatrixStack::Reset(const Matrix &matrix) {
+    top_ = 0;
+    stack_[0] = matrix;
+}
+
+void MatrixStack::Reserve(int depth) {
+    if (depth + 1 > int(stack_.size()))
+        stack_.resize(depth + 1);
+}
+
+void MatrixStack::Push() {
+    if (top_ + 1 == int(stack_.size()))
+        stack_.resize(top_ + 2);
+    stack_[top_ + 1] = stack_[top_];
+    top_++;
+}
+
+void MatrixStack::Pop() {
+    assert(top_ > 0);
+    top_--;
+}
@@ -0,0 +1,64 @@
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include <vector>
+
+// A 4x4 float matrix stored in column-major order, the layout used by
+// @glLoadMatrixf@. The storage is 16-byte aligned so that columns can be
+// loaded directly into SSE registers.
+struct Matrix {
+    alignas(16) float m[16];
+
+    // Returns the identity matrix.
+    static Matrix identity();
+
+    // Returns the product @a * b@.
+    static Matrix multiply(const Matrix &a, const Matrix &b);
+
+    // The following post-multiply @this@ by the corresponding transformation,
+    // exactly like the fixed-function call of the same name would multiply
+    // the current matrix. Angles are in degrees.
+    void translate(float x, float y, float z);
+    void scale(float x, float y, float z);
+    void rotateX(float angle);
+    void rotateY(float angle);
+    void rotateZ(float angle);
+};
+
+// A stack of matrices evaluated on the CPU.
+//
+// It mirrors the fixed-function model view stack, but lives in our own memory
+// so that the world matrix of every node is visible to our code and only the
+// final matrices need to be handed to OpenGL. Unlike the OpenGL stack it has
+// no fixed depth: it grows as needed, and keeps its capacity when reset.
+class MatrixStack {
+    public:
+        // Constructs a stack holding only the identity matrix.
+        MatrixStack();
+
+        // Replaces the whole stack with the given matrix.
+        void Reset(const Matrix &matrix);
+
+        // Makes room for @depth@ pushes, so that pushing up to that depth
+        // does not allocate.
+        void Reserve(int depth);
+
+        // Duplicates the top matrix.
+        void Push();
+
+        // Discards the top matrix.
+        void Pop();
+
+        // The current matrix.
+        Matrix &Top() { return stack_[top_]; }
+        const Matrix &Top() const { return stack_[top_]; }
+
+        // Current depth of the stack; 0 when only the base matrix is left.
+        int Depth() const { return top_; }
+
+    private:
+        std::vector<Matrix> stack_;
+        int top_;
+};
+
+#endif /* end of include guard: MATRIX_H */
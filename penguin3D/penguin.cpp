@@ -40,12 +40,27 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
-
+#include <float.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "animation.h"
+#include "arena.h"
+#include "channeltrack.h"
+#include "command.h"
 #include "component.h"
+#include "compressedtrack.h"
+#include "crowd.h"
 #include "image.h"
 #include "keyframe.h"
+#include "keyframefile.h"
+#include "keyframetext.h"
+#include "penguin.h"
+#include "posetable.h"
 #include "timer.h"
-#include "vector.h"
+#include "triplebuffer.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 // Global Variables
@@ -89,36 +104,37 @@ const GLdouble FAR_CLIP    = 1000.0;
 
 // Light settings
 float light_angle = 90;
-const float LIGHT_CIRCLE_RADIUS = 100;
 
-enum { SHADE_FLAT, SHADE_SMOOTH };
 int shadeModel = SHADE_FLAT;
 
 // Render settings
-enum {
-    WIREFRAME,
-    SOLID,
-    OUTLINED,
-    METAL,
-    MATTE
-} ;
-
 int renderStyle = WIREFRAME;
 
 // Animation settings
 int animate_mode = 0;                       // 0 = no anim, 1 = animate
 
 // Keyframe settings
-const char filenameKF[] = "keyframes.txt";  // file for loading / saving
-                                            // keyframes
-
-int maxValidKeyframe   = 10;                 // index of max VALID keyframe (in
-                                            // keyframe list)
 const int KEYFRAME_MIN = 0;
-const int KEYFRAME_MAX = 32;                // README: specifies the max
-                                            // number of keyframes
 
-Keyframe keyframes[KEYFRAME_MAX];           // list of keyframes
+KeyframeTrack keyframes;                    // list of keyframes, sorted by
+                                            // time (see animation.h)
+
+ChannelTrack channels;          // the keyframes one DOF channel at a time,
+bool channelsStale = true;      // for playback (see channeltrack.h); rebuilt
+                                // from the keyframes when stale
+
+ChannelCursor playbackCursor;   // place in the channels while animating or
+                                // dumping frames
+
+PoseTable bakedPoses;           // the channels baked at BAKE_RATE (see
+bool bakedPosesStale = true;    // posetable.h); rebaked when stale
+int playBakedPoses = 0;         // 1 = animate and dump frames from the
+                                // baked poses rather than the channels
+int quantizeBakedPoses = 0;     // 1 = bake poses to 16 bits per DOF
+GLUI_Checkbox *playBakedPosesBox = 0;       // controls of the two above,
+GLUI_Checkbox *quantizeBakedPosesBox = 0;   // read in bakeCheckbox()
+
+GLUI_Spinner *keyframeSpinner = 0;  // keyframe ID control
 
 // Frame settings
 char filenameF[128];            // storage for frame filename
@@ -131,12 +147,39 @@ const float DUMP_SEC_PER_FRAME = 1.0 / DUMP_FRAME_PER_SEC;
 
 // Time settings
 Timer animationTimer;
-Timer frameRateTimer;
 
 // README: specifies the max time of the animation
 const float TIME_MIN = 0.0;
 const float TIME_MAX = 10.0; 
-const float SEC_PER_FRAME = 1.0 / 60.0;
+
+// Paces the frames of the animation to SEC_PER_FRAME (see animate()). The
+// frame timer of a run that was stopped does nothing, so that stopping the
+// animation does not have to cancel it.
+FramePacer framePacer(SEC_PER_FRAME);
+int animationRun = 0;       // run the pending frame timer belongs to
+
+// Fixed-timestep animation (see animationLoop()). While the animation runs,
+// a thread of its own updates the poses, and those of the crowd,
+// updateRate times per second of animationTimer however often frames are
+// drawn. It hands every update to the GLUT thread through a TripleBuffer, so
+// neither thread ever waits for the other, and display() draws STATE blended
+// between the last two poses of the latest update. If the thread falls more
+// than MAX_UPDATES_BEHIND updates behind, it skips ahead rather than trying
+// to catch up.
+//
+// The thread reads the channels or baked poses and the crowd members, which
+// the GLUT thread only changes while the thread is stopped (see
+// stopAnimationThread()).
+int updateRate = 60;
+const int UPDATE_RATE_MIN = 1;
+const int UPDATE_RATE_MAX = 1000;
+const int MAX_UPDATES_BEHIND = 8;
+
+TripleBuffer<AnimationUpdate> animationUpdates;
+std::thread animationThread;
+std::mutex animationMutex;              // guards animationStopping
+std::condition_variable animationWake;  // wakes the thread to stop it
+bool animationStopping = false;
 
 // Joint settings
 
@@ -155,17 +198,41 @@ const float SEC_PER_FRAME = 1.0 / 60.0;
 //      animate() function as described above) to
 //      specify the appropriate transformations.
 Keyframe STATE; // called joint_ui_data() in A2. 
-Entity PENGUIN;
+Arena rigArena; // Owns PENGUIN and all of its components.
+Entity &PENGUIN = *rigArena.New<Entity>();
 bool colorPenguin = true; // A global variable to know if penguin is colored 
 int coloredMaterials = true;
-Entity wireFrameMode;
-Entity solidMode;
 
-Component *ENABLE_COLOR_PENGUIN =
-Component::function([]{ colorPenguin = true; });
-
-Component *DISABLE_COLOR_PENGUIN =
-Component::function([]{ colorPenguin = false; });
+// The render pipeline wrapping PENGUIN for the current render settings. It is
+// built by currentPipeline() and reused every frame until renderStyle,
+// shadeModel or coloredMaterials change, so drawing a frame allocates nothing.
+// The pipeline is compiled into pipelineCommands, which is what gets executed.
+// All of its components are allocated in pipelineArena.
+Component *pipeline = 0;
+Arena pipelineArena;
+CommandBuffer pipelineCommands;
+int pipelineStyle = -1;
+int pipelineShade = -1;
+int pipelineColored = -1;
+
+// Crowd mode (see the --crowd option). The crowd replays pipelineCommands
+// once per member, each member in its own pose.
+int crowdSize = 0;
+Crowd *crowd = 0;
+
+// Light and material settings referenced by the pipeline components. The
+// light position is updated in place every frame from light_angle.
+float light_pos[] = { 0, 0, 25, 0 };
+
+const float METAL_SPECULAR[] = { 0.70, 0.70, 0.70, 1.0 };
+const float METAL_DIFFUSE[]  = { 0.50, 0.50, 0.50, 1.0 };
+const float METAL_SHININESS  = 128;
+
+const float MATTE_SPECULAR[] = { 0.01, 0.01, 0.01, 1.0 };
+const float MATTE_DIFFUSE[]  = { 0.50, 0.50, 0.50, 1.0 };
+const float MATTE_SHININESS  = 0;
+
+const float LIGHT_SPECULAR[] = { 0.8, 0.8, 0.8, 1.0 };
 
 // README: To change the range of a particular DOF,
 // simply change the appropriate min/max values below
@@ -256,8 +323,6 @@ const float BODY_DEPTH = 1.25;
 // Function Declarations
 ///////////////////////////////////////////////////////////////////////////////
 
-inline float deg2rad(float deg) { return deg * M_PI / 180; }
-
 // Initialization functions
 void initDS();
 void initGlut(int argc, char** argv);
@@ -265,109 +330,53 @@ void initGlui();
 void initGl();
 
 
-// Callbacks for handling events in glut
-void reshape(int w, int h);
-void animate();
-void display(void); // The main function that displays the penguin 
-void mouse(int button, int state, int x, int y); // Mouse event handler
-void motion(int x, int y);
+// Callbacks for handling events in glut (see also penguin.h)
+void animate(int run);
+void scheduleFrame();
+void startAnimationThread();
+void animationLoop(double time, double step, float duration,
+                   Keyframe::Pose pose, float poseTime);
 
-// Functions to help draw the object
-Vector getInterpolatedJointDOFS(float time);
+// Functions to help draw the object (see also penguin.h)
+bool saveKeyframes(const char *filename);
+void updateKeyframeSpinner();
+ChannelTrack &playbackChannels();
+PoseTable &playbackPoses();
+Keyframe::Pose getInterpolatedJointDOFS(float time, ChannelCursor *cursor = 0);
 
 ///////////////////////////////////////////////////////////////////////////////
 // Functions
 ///////////////////////////////////////////////////////////////////////////////
 
-// A Supplier that returns DOF values from the current state.
-class DOFSupplier : public Supplier<float> {
-    public:
-        DOFSupplier(int dof) { dof_ = dof; }
-        virtual ~DOFSupplier() {}
-        virtual float Get() { return STATE.getDOF(dof_); }
-    private:
-        int dof_;
-};
-
-#define DOFS(dof) (new DOFSupplier(dof))
-
-// main() function
-// Initializes the user interface (and any user variables)
-// then hands over control to the event handler, which calls
-// display() whenever the GL window needs to be redrawn.
-
-//--------------------------------------------------------
-// main() function
-//--------------------------------------------------------
-// Initializes the user interface (and any user variables)
-// then hands over control to the event handler, which calls 
-// display() whenever the GL window needs to be redrawn.
-int main(int argc, char** argv)
-{
-
-    // Process program arguments
-    if(argc != 3) {
-        printf("Usage: demo [width] [height]\n");
-        printf("Using 640x480 window by default...\n");
-        Win[0] = 640; // width 
-        Win[1] = 480; // height 
-    } else {
-        Win[0] = atoi(argv[1]); // window width
-        Win[1] = atoi(argv[2]); // window height 
-    }
-
-
-
-    // Initialize data structs, glut, glui, and opengl
-  //  initDS(); // Initialize key frames
-  //  initGlut(argc, argv); // Initialize Glut
-  //  initGlui(); // Set up user interface 
-  //  initGl(); // Initialize openGL 
+// A Binding to a DOF of the pose the rig is drawn for, e.g. STATE.
+#define DOFS(index) (Binding::dof(index))
 
-    // Initialize GLUT
-    glutInit(&argc, argv);
-    glutInitDisplayMode(GLUT_DOUBLE|GLUT_RGB|GLUT_DEPTH);
-    glutInitWindowPosition(0, 0);
-    glutInitWindowSize(Win[0], Win[1]);
-    windowID = glutCreateWindow(argv[0]);
-
-    // Set up callbacks
-    glutReshapeFunc(reshape);
-    glutDisplayFunc(display);
-    glutMouseFunc(mouse);
-    glutMotionFunc(motion);
- 
-    initGlui(); // Set up UI
-
-//----------------------------------------------------------------------------------------------------------------------------------------------------------------
-// DRAW THE PENGUIN HERE
-//----------------------------------------------------------------------------------------------------------------------------------------------------------------
-
-    // Initialize wireFrame Rendering Mode 
-    wireFrameMode.AddComponent(Component::disable(GL_LIGHTING));	// no lights
-    wireFrameMode.AddComponent(Component::polygonMode(GL_FRONT_AND_BACK, GL_LINE)); // draw with just line
-
-    // Initialize solid Rendering Mode   
-    solidMode.AddComponent(Component::disable(GL_LIGHTING)); // no lights
-    solidMode.AddComponent(Component::polygonMode(GL_FRONT_AND_BACK, GL_FILL)); // draw with filled cuboids 
+// Builds PENGUIN in rigArena.
+void buildPenguin() {
+    // Everything the rig is built from is allocated in rigArena.
+    ArenaScope rigScope(rigArena);
+    buildPenguin(PENGUIN);
+}
 
+// Builds the penguin rig into the empty entity @penguin@, allocating its
+// components in the current arena.
+void buildPenguin(Entity &penguin) {
     //-----------------------------------
     // Eye 
     //-----------------------------------
-    Entity eye;
+    Entity &eye = *Component::entity();
     eye.AddComponent(Component::color(0.0, 0.0, 0.0)->onlyWhen(&colorPenguin));
     eye.AddComponent(Component::circle((-0.7), 0, 0, 0.1));
-    eye.pushPopAttribute(GL_COLOR_BUFFER_BIT);
 
     //-----------------------------------
     // Beak   
     //-----------------------------------
-    Entity Stagnantbeak; // The upper beak that doesn't move 
+    Entity &Stagnantbeak = *Component::entity(); // The upper beak that doesn't move 
     Stagnantbeak.AddComponent(Component::color(0.7, 0.6, 0.4)->onlyWhen(&colorPenguin));
     Stagnantbeak.AddComponent(Component::cuboid((-HEAD_WIDTH/8), 0, -HEAD_DEPTH/2, HEAD_WIDTH/4, HEAD_HEIGHT*0.1,  HEAD_DEPTH/4)); 
 
     // The lower beak that moves up and down
-    Entity beak;
+    Entity &beak = *Component::entity();
     beak.AddComponent(Component::translatable(DOFS(Keyframe::BEAK_USElESS), DOFS(Keyframe::BEAK), DOFS(Keyframe::BEAK_USElESS))); // note: Must put translate before color as order is important 
     beak.AddComponent(Component::color(0.4, 0.5, 0.4)->onlyWhen(&colorPenguin));
     beak.AddComponent(Component::cuboid((-HEAD_WIDTH/8), 0, -HEAD_DEPTH/2, HEAD_WIDTH/4, HEAD_HEIGHT*0.1,  HEAD_DEPTH/4)); 
@@ -375,7 +384,7 @@ int main(int argc, char** argv)
     //-----------------------------------
     // Head 
     //-----------------------------------
-    Entity head;
+    Entity &head = *Component::entity();
     head.AddComponent(Component::rotatable(DOFS(Keyframe::HEAD), 0,0));	// Available enumerations for KeyFrame in keyframe.h 
     head.AddComponent(Component::color(0.9, 0.5, 0.5)->onlyWhen(&colorPenguin));
     head.AddComponent(Component::cuboid((-HEAD_WIDTH/4)*3, 0, -HEAD_DEPTH/2, HEAD_WIDTH/8, HEAD_HEIGHT*0.8,  HEAD_DEPTH/2));
@@ -386,7 +395,7 @@ int main(int argc, char** argv)
     //-----------------------------------
     // Right Elbow 
     //-----------------------------------
-    Entity rightElbow;
+    Entity &rightElbow = *Component::entity();
     rightElbow.AddComponent(Component::rotatable(DOFS(Keyframe::USELESS),DOFS(Keyframe::USELESS), DOFS(Keyframe::R_ELBOW)));
     rightElbow.AddComponent(Component::color(0.4, 0.4, 0.4)->onlyWhen(&colorPenguin));
     rightElbow.AddComponent(Component::cuboid((-HEAD_WIDTH/8), -HEAD_HEIGHT*0.5, -HEAD_DEPTH/2, HEAD_WIDTH/8, HEAD_HEIGHT*0.1,  HEAD_DEPTH/2)); 
@@ -394,7 +403,7 @@ int main(int argc, char** argv)
     //-----------------------------------
     // Right Shoulder  
     //-----------------------------------
-    Entity rightShoulder;
+    Entity &rightShoulder = *Component::entity();
     rightShoulder.AddComponent(Component::rotatable(DOFS(Keyframe::R_SHOULDER_ROLL),DOFS(Keyframe::R_SHOULDER_YAW), DOFS(Keyframe::R_SHOULDER_PITCH)));
     rightShoulder.AddComponent(Component::color(0.7, 0.5, 0.3)->onlyWhen(&colorPenguin));
     rightShoulder.AddComponent(Component::cuboid((-HEAD_WIDTH/8), -HEAD_HEIGHT*0.75, -HEAD_DEPTH/2, HEAD_WIDTH/8, HEAD_HEIGHT/3,  HEAD_DEPTH/2)); 
@@ -403,7 +412,7 @@ int main(int argc, char** argv)
     //-----------------------------------
     // Left Elbow  
     //-----------------------------------
-    Entity leftElbow;
+    Entity &leftElbow = *Component::entity();
     leftElbow.AddComponent(Component::rotatable(DOFS(Keyframe::USELESS),DOFS(Keyframe::USELESS), DOFS(Keyframe::L_ELBOW)));
     leftElbow.AddComponent(Component::color(0.8, 0.8, 0.8)->onlyWhen(&colorPenguin));
     leftElbow.AddComponent(Component::cuboid((-HEAD_WIDTH/8), -HEAD_HEIGHT*0.5, -HEAD_DEPTH/2, HEAD_WIDTH/8, HEAD_HEIGHT*0.1,  HEAD_DEPTH/2)); 
@@ -411,7 +420,7 @@ int main(int argc, char** argv)
     //-----------------------------------
     // Left Shoulder  
     //-----------------------------------
-    Entity leftShoulder;
+    Entity &leftShoulder = *Component::entity();
     leftShoulder.AddComponent(Component::rotatable(DOFS(Keyframe::L_SHOULDER_ROLL),DOFS(Keyframe::L_SHOULDER_YAW), DOFS(Keyframe::L_SHOULDER_PITCH)));
     leftShoulder.AddComponent(Component::color(0.5, 0.7, 0.3)->onlyWhen(&colorPenguin));
     leftShoulder.AddComponent(Component::cuboid((-HEAD_WIDTH/8), -HEAD_HEIGHT*0.75, -HEAD_DEPTH/2, HEAD_WIDTH/8, HEAD_HEIGHT/3,  HEAD_DEPTH/2)); 
@@ -421,7 +430,7 @@ int main(int argc, char** argv)
     //-----------------------------------
     // Right Knee 
     //-----------------------------------
-    Entity rightKnee;
+    Entity &rightKnee = *Component::entity();
     rightKnee.AddComponent(Component::rotatable(DOFS(Keyframe::USELESS),DOFS(Keyframe::USELESS), DOFS(Keyframe::R_KNEE)));
     rightKnee.AddComponent(Component::color(0.4, 0.4, 0.4)->onlyWhen(&colorPenguin));
     rightKnee.AddComponent(Component::cuboid((-HEAD_WIDTH/8), -HEAD_HEIGHT*0.5, -HEAD_DEPTH*0.1, HEAD_WIDTH/8, HEAD_HEIGHT*0.1,  HEAD_DEPTH*0.1)); 
@@ -429,7 +438,7 @@ int main(int argc, char** argv)
     //-----------------------------------
     // Right Hip  
     //-----------------------------------
-    Entity rightHip;
+    Entity &rightHip = *Component::entity();
     rightHip.AddComponent(Component::rotatable(DOFS(Keyframe::R_HIP_ROLL),DOFS(Keyframe::R_HIP_YAW), DOFS(Keyframe::R_HIP_PITCH)));
     rightHip.AddComponent(Component::color(0.2, 0.4, 0.6)->onlyWhen(&colorPenguin));
     rightHip.AddComponent(Component::cuboid((-HEAD_WIDTH*0.1), -HEAD_HEIGHT*0.5, -HEAD_DEPTH*0.1, HEAD_WIDTH*0.1, 0,  HEAD_DEPTH*0.1));
@@ -438,7 +447,7 @@ int main(int argc, char** argv)
     //-----------------------------------
     // Left Knee 
     //-----------------------------------
-    Entity leftKnee;
+    Entity &leftKnee = *Component::entity();
     leftKnee.AddComponent(Component::rotatable(DOFS(Keyframe::USELESS),DOFS(Keyframe::USELESS), DOFS(Keyframe::L_KNEE)));
     leftKnee.AddComponent(Component::color(0.6, 0.3, 0.3)->onlyWhen(&colorPenguin));
     leftKnee.AddComponent(Component::cuboid((-HEAD_WIDTH/8), -HEAD_HEIGHT*0.5, -HEAD_DEPTH*0.1, HEAD_WIDTH/8, HEAD_HEIGHT*0.1,  HEAD_DEPTH*0.1)); 
@@ -446,7 +455,7 @@ int main(int argc, char** argv)
     //-----------------------------------
     // Left Hip  
     //-----------------------------------
-    Entity leftHip;
+    Entity &leftHip = *Component::entity();
     leftHip.AddComponent(Component::color(0.4, 0.1, 0.7)->onlyWhen(&colorPenguin));
     leftHip.AddComponent(Component::rotatable(DOFS(Keyframe::L_HIP_ROLL),DOFS(Keyframe::L_HIP_YAW), DOFS(Keyframe::L_HIP_PITCH)));
     leftHip.AddComponent(Component::cuboid((-HEAD_WIDTH*0.1), -HEAD_HEIGHT*0.5, -HEAD_DEPTH*0.1, HEAD_WIDTH*0.1, 0,  HEAD_DEPTH*0.1));
@@ -454,7 +463,7 @@ int main(int argc, char** argv)
     //-----------------------------------
     // Body    
     //-----------------------------------
-    Entity body;
+    Entity &body = *Component::entity();
     body.AddComponent(Component::color(0.5, 1, 0.5)->onlyWhen(&colorPenguin));
     body.AddComponent(Component::cuboid(BODY_WIDTH, BODY_HEIGHT, BODY_DEPTH/2));
     body.AddComponent(head.attach(0, BODY_HEIGHT/2 - PAD, 0));
@@ -465,26 +474,10 @@ int main(int argc, char** argv)
     //-----------------------------------
     // Penguin as a whole    
     //-----------------------------------
-    // note: PENGUIN is a global variable outside this function. 
     // Root translation and rotation can be controlled by ROOT_* DOFs.
-    PENGUIN.AddComponent(Component::translatable(DOFS(Keyframe::ROOT_TRANSLATE_X), DOFS(Keyframe::ROOT_TRANSLATE_Y), DOFS(Keyframe::ROOT_TRANSLATE_Z)));
-    PENGUIN.AddComponent(Component::rotatable(DOFS(Keyframe::ROOT_ROTATE_X), DOFS(Keyframe::ROOT_ROTATE_Y), DOFS(Keyframe::ROOT_ROTATE_Z)));
-    PENGUIN.AddComponent(body.attach()); // put body after translation and rotation 
-
-
-//----------------------------------------------------------------------------------------------------------------------------------------------------------------
-//Finish Drawing the Penguin and connecting all connections 
-//----------------------------------------------------------------------------------------------------------------------------------------------------------------
-
-    // Set up OpenGL
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_NORMALIZE);
-    glClearColor(0.7f, 0.7f, 0.9f, 1.0f);
-
-    // Invoke the standard GLUT main event loop
-    glutMainLoop();
-
-    return 0;         // never reached
+    penguin.AddComponent(Component::translatable(DOFS(Keyframe::ROOT_TRANSLATE_X), DOFS(Keyframe::ROOT_TRANSLATE_Y), DOFS(Keyframe::ROOT_TRANSLATE_Z)));
+    penguin.AddComponent(Component::rotatable(DOFS(Keyframe::ROOT_ROTATE_X), DOFS(Keyframe::ROOT_ROTATE_Y), DOFS(Keyframe::ROOT_ROTATE_Z)));
+    penguin.AddComponent(body.attach()); // put body after translation and rotation 
 }
 
 // Load Keyframe button handler. Called when the "load keyframe" button is
@@ -493,6 +486,11 @@ void loadKeyframeButton(int)
 {
     // Get the keyframe ID from the UI
     int keyframeID = STATE.getID();
+    if ( keyframeID >= keyframes.size() ) {
+        sprintf(msg, "Status: Keyframe %d does not exist", keyframeID);
+        status->set_text(msg);
+        return;
+    }
 
     // Update the 'STATE' variable with the appropriate
     // entry from the 'keyframes' array (the list of keyframes)
@@ -514,89 +512,174 @@ void updateKeyframeButton(int)
     // Get the keyframe ID from the UI
     int keyframeID = STATE.getID();
 
-    // Update the 'maxValidKeyframe' index variable
-    // (it will be needed when doing the interpolation)
-    maxValidKeyframe = keyframeID;
-
-    // Update the appropriate entry in the 'keyframes' array
-    // with the 'STATE' data
-    keyframes[keyframeID] = STATE;
+    // Update the appropriate entry in the 'keyframes' list with the 'STATE'
+    // data, or add a new keyframe for the ID after the last one. Either way
+    // the keyframe goes where its time puts it, which may change its ID.
+    int updatedID;
+    if ( keyframeID < keyframes.size() )
+        updatedID = keyframes.Set(keyframeID, STATE);
+    else
+        updatedID = keyframes.Insert(STATE);
+    STATE.setID(updatedID);
+    keyframesChanged();
+    glui_keyframe->sync_live();
 
     // Let the user know the values have been updated
-    sprintf(msg, "Status: Keyframe %d updated successfully", keyframeID);
+    if ( updatedID == keyframeID )
+        sprintf(msg, "Status: Keyframe %d updated successfully", keyframeID);
+    else
+        sprintf(msg, "Status: Keyframe %d updated successfully and moved to %d",
+                keyframeID, updatedID);
     status->set_text(msg);
 }
 
-// Load Keyframes From File button handler. Called when the "load keyframes from file" button is pressed
-// ASSUMES THAT THE FILE FORMAT IS CORRECT, ie, there is no error checking!
-void loadKeyframesFromFileButton(int) 
+// Lets the keyframe ID control select any keyframe, or the one after the
+// last to add a new keyframe.
+void updateKeyframeSpinner()
 {
-    // Open file for reading
-    FILE* file = fopen(filenameKF, "r");
-    if ( file == NULL ) {
-        sprintf(msg, "Status: Failed to open file %s", filenameKF);
-        status->set_text(msg);
-        return;
+    if ( keyframeSpinner != NULL )
+        keyframeSpinner->set_int_limits(KEYFRAME_MIN, keyframes.size(), GLUI_LIMIT_CLAMP);
+}
+
+// Called whenever the keyframes change: updates the keyframe ID control and
+// has the channels rebuilt and the poses rebaked the next time they are
+// played. A running animation thread is restarted to play the new ones.
+void keyframesChanged()
+{
+    bool animating = stopAnimationThread();
+    updateKeyframeSpinner();
+    channelsStale = true;
+    bakedPosesStale = true;
+    playbackCursor.Reset();
+    if ( crowd != 0 )
+        crowd->SetDuration(keyframes.duration());
+    if ( animating )
+        startAnimationThread();
+}
+
+// Returns the channels of the keyframes, building them first if the keyframes
+// changed since. Building them takes a pass over the keyframes, so it is left
+// until playback rather than done on every edit or load.
+ChannelTrack &playbackChannels()
+{
+    if ( channelsStale ) {
+        channels.Build(keyframes.view());
+        channelsStale = false;
+    }
+    return channels;
+}
+
+// Returns the channels baked at BAKE_RATE, quantized if quantizeBakedPoses is
+// set, baking them first if the keyframes or the setting changed since.
+PoseTable &playbackPoses()
+{
+    if ( bakedPosesStale || bakedPoses.quantized() != bool(quantizeBakedPoses) ) {
+        bakedPoses.Bake(playbackChannels(), BAKE_RATE, quantizeBakedPoses);
+        bakedPosesStale = false;
     }
+    return bakedPoses;
+}
 
-    // Read in maxValidKeyframe first
-    fscanf(file, "%d", &maxValidKeyframe);
+// Bake control callback. Called when either bake checkbox changes: bakes the
+// poses right away if they are played, and shows their size and error. The
+// checkboxes have no live variables, since the animation thread reads them;
+// they are copied here, with the thread stopped.
+void bakeCheckbox(int)
+{
+    bool animating = stopAnimationThread();
+    playBakedPoses = playBakedPosesBox->get_int_val();
+    quantizeBakedPoses = quantizeBakedPosesBox->get_int_val();
 
-    // Now read in all keyframes in the format:
-    //    id
-    //    time
-    //    DOFs
-    //
-    for ( int i = 0; i <= maxValidKeyframe; i++ ) {
-        fscanf(file, "%d", keyframes[i].getIDPtr());
-        fscanf(file, "%f", keyframes[i].getTimePtr());
+    if ( !playBakedPoses ) {
+        sprintf(msg, "Status: Playing the keyframes");
+    } else {
+        PoseTable &poses = playbackPoses();
+        sprintf(msg, "Status: Playing %d baked poses (%d KB, error %g)",
+                poses.rows(), int(poses.bytes() / 1024), poses.maxError());
+    }
+    status->set_text(msg);
+    if ( animating )
+        startAnimationThread();
+}
+
+// Update rate control callback. Restarts a running animation thread, which
+// reads the rate when it starts.
+void updateRateSpinner(int)
+{
+    if ( stopAnimationThread() )
+        startAnimationThread();
+}
 
-        for ( int j = 0; j < Keyframe::NUM_JOINT_ENUM; j++ )
-            fscanf(file, "%f", keyframes[i].getDOFPtr(j));
+// Loads the keyframe list from the given file, either a text list (see
+// keyframetext.h) or a keyframe file (see keyframefile.h), which is used in
+// place. Returns false, leaving the keyframes unchanged, if the file cannot be
+// opened or is not in either format, and describes the problem in @error@ if
+// one is given.
+bool loadKeyframes(const char *filename, KeyframeTextError *error)
+{
+    KeyframeTrack track;
+    if ( isKeyframeFile(filename) ) {
+        if ( !track.Map(filename) ) {
+            if ( error != NULL ) {
+                error->line = 0;
+                error->message = "not a valid keyframe file";
+            }
+            return false;
+        }
+    } else if ( !readKeyframeText(filename, track, error) ) {
+        return false;
     }
 
-    // Close file
-    fclose(file);
+    keyframes.Swap(track);
+    keyframesChanged();
+    return true;
+}
+
+// Writes a message about a keyframe list that could not be loaded to @out@.
+void formatLoadError(char *out, const char *filename,
+                     const KeyframeTextError &error)
+{
+    if ( error.line > 0 )
+        sprintf(out, "Failed to load %s, line %d: %s", filename, error.line,
+                error.message);
+    else
+        sprintf(out, "Failed to load %s: %s", filename, error.message);
+}
+
+// Load Keyframes From File button handler. Called when the "load keyframes from file" button is pressed
+void loadKeyframesFromFileButton(int) 
+{
+    KeyframeTextError error;
+    if ( !loadKeyframes(filenameKF, &error) ) {
+        char reason[sizeof(msg) - 16];
+        formatLoadError(reason, filenameKF, error);
+        sprintf(msg, "Status: %s", reason);
+        status->set_text(msg);
+        return;
+    }
 
     // Let the user know the keyframes have been loaded
     sprintf(msg, "Status: Keyframes loaded successfully");
     status->set_text(msg);
 }
 
+// Saves the keyframe list to the given file as text. Returns false if the
+// file cannot be written.
+bool saveKeyframes(const char *filename)
+{
+    return writeKeyframeText(filename, keyframes.view());
+}
+
 // Save Keyframes To File button handler. Called when the "save keyframes to
 // file" button is pressed
 void saveKeyframesToFileButton(int) 
 {
-    // Open file for writing
-    FILE* file = fopen(filenameKF, "w");
-    if ( file == NULL ) {
-        sprintf(msg, "Status: Failed to open file %s", filenameKF);
+    if ( !saveKeyframes(filenameKF) ) {
+        sprintf(msg, "Status: Failed to save file %s", filenameKF);
         status->set_text(msg);
         return;
     }
 
-    // Write out maxValidKeyframe first
-    fprintf(file, "%d\n", maxValidKeyframe);
-    fprintf(file, "\n");
-
-    // Now write out all keyframes in the format:
-    //    id
-    //    time
-    //    DOFs
-    //
-    for ( int i = 0; i <= maxValidKeyframe; i++ ) {
-        fprintf(file, "%d\n", keyframes[i].getID());
-        fprintf(file, "%f\n", keyframes[i].getTime());
-
-        for ( int j = 0; j < Keyframe::NUM_JOINT_ENUM; j++ )
-            fprintf(file, "%f\n", keyframes[i].getDOF(j));
-
-        fprintf(file, "\n");
-    }
-
-    // Close file
-    fclose(file);
-
     // Let the user know the keyframes have been saved
     sprintf(msg, "Status: Keyframes saved successfully");
     status->set_text(msg);
@@ -612,22 +695,26 @@ void animateButton(int)
     if ( animate_mode == 0 ) 
    {
         // start animation
-        frameRateTimer.reset();
+        framePacer.reset();
         animationTimer.reset();
+        startAnimationThread();
 
         animate_mode = 1;
-        GLUI_Master.set_glutIdleFunc(animate);
+        scheduleFrame();
 
         // Let the user know the animation is running
         sprintf(msg, "Status: Animating...");
         status->set_text(msg);
     } else {
         // stop animation
+        stopAnimationThread();
         animate_mode = 0;
-        GLUI_Master.set_glutIdleFunc(NULL);
+        animationRun++;
 
-        // Let the user know the animation has stopped
-        sprintf(msg, "Status: Animation stopped");
+        // Let the user know the animation has stopped, and how many frames
+        // were late
+        sprintf(msg, "Status: Animation stopped, %d of %d frame(s) late",
+                framePacer.missed(), framePacer.frames());
         status->set_text(msg);
     }
 }
@@ -637,14 +724,26 @@ void animateButton(int)
 void renderFramesToFileButton(int) 
 {
     // Calculate number of frames to generate based on dump frame rate
-    int numFrames = int(keyframes[maxValidKeyframe].getTime() * DUMP_FRAME_PER_SEC) + 1;
+    int numFrames = int(keyframes.duration() * DUMP_FRAME_PER_SEC) + 1;
+
+    // Interpolate the joint DOFs of all frames at once
+    const int dofs = Keyframe::NUM_JOINT_ENUM;
+    std::vector<float> times(numFrames);
+    std::vector<float> poses(numFrames * dofs);
+    for ( frameNumber = 0; frameNumber < numFrames; frameNumber++ )
+        times[frameNumber] = frameNumber * DUMP_SEC_PER_FRAME;
+    if ( playBakedPoses )
+        playbackPoses().Sample(&times[0], numFrames, &poses[0]);
+    else
+        playbackChannels().Sample(&times[0], numFrames, &poses[0], &playbackCursor);
 
     // Generate frames and save to file
     frameToFile = 1;
     for ( frameNumber = 0; frameNumber < numFrames; frameNumber++ ) 
     {
         // Get the interpolated joint DOFs
-        STATE.setDOFVector( getInterpolatedJointDOFS(frameNumber * DUMP_SEC_PER_FRAME) );
+        for ( int dof = 0; dof < dofs; dof++ )
+            STATE.setDOF(dof, poses[frameNumber * dofs + dof]);
 
         // Let the user know which frame is being rendered
         sprintf(msg, "Status: Rendering frame %d...", frameNumber);
@@ -879,9 +978,9 @@ void initGlui() {
 
     // Create a control to specify a keyframe (for updating / loading a keyframe)
     glui_keyframe->add_column_to_panel(glui_panel, false);
-    glui_spinner = glui_keyframe->add_spinner_to_panel(glui_panel, "Keyframe ID:", GLUI_SPINNER_INT, STATE.getIDPtr());
-    glui_spinner->set_int_limits(KEYFRAME_MIN, KEYFRAME_MAX - 1, GLUI_LIMIT_CLAMP);
-    glui_spinner->set_speed(SPINNER_SPEED);
+    keyframeSpinner = glui_keyframe->add_spinner_to_panel(glui_panel, "Keyframe ID:", GLUI_SPINNER_INT, STATE.getIDPtr());
+    updateKeyframeSpinner();
+    keyframeSpinner->set_speed(SPINNER_SPEED);
 
     glui_keyframe->add_separator();
 
@@ -897,6 +996,20 @@ void initGlui() {
     glui_keyframe->add_button_to_panel(glui_panel, "Save Keyframes To File", 0, saveKeyframesToFileButton);
     glui_keyframe->add_button_to_panel(glui_panel, "Render Frames To File", 0, renderFramesToFileButton);
 
+    // Create a control to set how many times per second the animation is
+    // updated, apart from how often it is drawn
+    glui_panel = glui_keyframe->add_panel("", GLUI_PANEL_NONE);
+    glui_spinner = glui_keyframe->add_spinner_to_panel(glui_panel, "Update Rate (Hz):", GLUI_SPINNER_INT, &updateRate, 0, updateRateSpinner);
+    glui_spinner->set_int_limits(UPDATE_RATE_MIN, UPDATE_RATE_MAX, GLUI_LIMIT_CLAMP);
+
+    // Add controls to play baked poses rather than the keyframes
+    glui_panel = glui_keyframe->add_panel("", GLUI_PANEL_NONE);
+    playBakedPosesBox = glui_keyframe->add_checkbox_to_panel(glui_panel, "Play Baked Poses", NULL, 0, bakeCheckbox);
+    playBakedPosesBox->set_int_val(playBakedPoses);
+    glui_keyframe->add_column_to_panel(glui_panel, false);
+    quantizeBakedPosesBox = glui_keyframe->add_checkbox_to_panel(glui_panel, "16-bit Baked Poses", NULL, 0, bakeCheckbox);
+    quantizeBakedPosesBox->set_int_val(quantizeBakedPoses);
+
     glui_keyframe->add_separator();
 
     // Add status line
@@ -935,77 +1048,356 @@ void initGlui() {
 
 
 // Calculates the interpolated joint DOF vector using Catmull-Rom
-// interpolation of the keyframes
-Vector getInterpolatedJointDOFS(float time) {
-    // Need to find the keyframes bewteen which
-    // the supplied time lies.
-    // At the end of the loop we have:
-    //    keyframes[i-1].getTime() < time <= keyframes[i].getTime()
-    //
-    int i = 0;
-    while ( i <= maxValidKeyframe && keyframes[i].getTime() < time )
-        i++;
-
-    // If time is before or at first defined keyframe, then
-    // just use first keyframe pose
-    if ( i == 0 )
-        return keyframes[0].getDOFVector();
-
-    // If time is beyond last defined keyframe, then just
-    // use last keyframe pose
-    if ( i > maxValidKeyframe )
-        return keyframes[maxValidKeyframe].getDOFVector();
-
-    // Need to normalize time to (0, 1]
-    time = (time - keyframes[i - 1].getTime()) / (keyframes[i].getTime() - keyframes[i - 1].getTime());
-
-    // Get appropriate data points and tangent vectors
-    // for computing the interpolation
-    Vector p0 = keyframes[i - 1].getDOFVector();
-    Vector p1 = keyframes[i].getDOFVector();
-
-    Vector t0, t1;
-    if ( i == 1 )                            // special case - at beginning of spline
-    {
-        t0 = keyframes[i].getDOFVector() - keyframes[i - 1].getDOFVector();
-        t1 = (keyframes[i + 1].getDOFVector() - keyframes[i - 1].getDOFVector()) * 0.5;
-    } else if ( i == maxValidKeyframe )        // special case - at end of spline
+// interpolation of the keyframes (see animation.h), sampled from their
+// channels so that DOFs that do not move cost nothing (see channeltrack.h),
+// or from the baked poses if they are played. Playback that moves forward in
+// time should pass a cursor to find the keys in O(1).
+Keyframe::Pose getInterpolatedJointDOFS(float time, ChannelCursor *cursor) {
+    if ( playBakedPoses )
+        return playbackPoses().Sample(time);
+    return playbackChannels().Sample(time, cursor);
+}
+
+// Fills @poses@ with the interpolated joint DOFs at @count@ times, one pose
+// after the other.
+void interpolatePoses(const float *times, int count, float *poses) {
+    if ( playBakedPoses )
+        playbackPoses().Sample(times, count, poses);
+    else
+        playbackChannels().Sample(times, count, poses);
+}
+
+// Converts the given keyframe list between the text and binary formats: a
+// text list is written as a keyframe file, and a keyframe file as a text list.
+int convertKeyframes(const char *from, const char *to) {
+    bool binary = isKeyframeFile(from);
+    KeyframeTextError error;
+    if (!loadKeyframes(from, &error)) {
+        formatLoadError(msg, from, error);
+        printf("%s\n", msg);
+        return 1;
+    }
+
+    bool saved = binary ? saveKeyframes(to)
+                        : writeKeyframeFile(to, keyframes.view());
+    if (!saved) {
+        printf("Failed to write %s\n", to);
+        return 1;
+    }
+    printf("Converted %d keyframes to a %s\n", keyframes.size(),
+           binary ? "text list" : "keyframe file");
+    return 0;
+}
+
+// Compresses the given keyframe list with the given settings and prints its
+// size before and after, as the time and values of every keyframe in floats,
+// the keys the channels keep, the channels that needed more bits, the time a
+// sample takes, and the largest error against the keyframes. Fails if the
+// error is over the limit.
+int compressKeyframes(const char *filename,
+                      const CompressionSettings &settings) {
+    if (settings.bits != 12 && settings.bits != 16) {
+        printf("Bits per value must be 12 or 16, not %d\n", settings.bits);
+        return 1;
+    }
+    KeyframeTextError error;
+    if (!loadKeyframes(filename, &error)) {
+        formatLoadError(msg, filename, error);
+        printf("%s\n", msg);
+        return 1;
+    }
+
+    CompressedTrack compressed;
+    Timer timer;
+    compressed.Compress(keyframes.view(), settings);
+    double compressMs = timer.elapsed() * 1000;
+
+    int samples = int(compressed.duration() / SEC_PER_FRAME) + 1;
+    std::vector<float> times(samples);
+    for (int s = 0; s < samples; s++)
+        times[s] = s * SEC_PER_FRAME;
+    std::vector<float> poses(samples * Keyframe::NUM_JOINT_ENUM);
+    timer.reset();
+    compressed.Sample(&times[0], samples, &poses[0]);
+    double sampleUs = timer.elapsed() * 1e6 / samples;
+
+    float angular, positional;
+    compressionError(keyframes.view(), compressed, &angular, &positional);
+
+    size_t source = size_t(keyframes.size()) *
+                    (Keyframe::NUM_JOINT_ENUM + 1) * sizeof(float);
+    printf("%d keyframes compressed to %d-bit values in %.1f ms\n",
+           keyframes.size(), settings.bits, compressMs);
+    printf("%-22s %12.1f KB\n", "keyframes", source / 1024.0);
+    printf("%-22s %12.1f KB\n", "compressed", compressed.bytes() / 1024.0);
+    printf("%-22s %12.2f\n", "ratio", double(source) / compressed.bytes());
+    printf("%-22s %12d of %d\n", "keys kept", compressed.keyCount(),
+           keyframes.size() * Keyframe::NUM_JOINT_ENUM);
+    int wider = 0;
+    for (int dof = 0; dof < Keyframe::NUM_JOINT_ENUM; dof++)
+        wider += compressed.bits(dof) > settings.bits;
+    printf("%-22s %12d\n", "wider channels", wider);
+    printf("%-22s %12.4f us\n", "sample", sampleUs);
+    printf("%-22s %12g (limit %g)\n", "max angular error", angular,
+           settings.angularError);
+    printf("%-22s %12g (limit %g)\n", "max positional error", positional,
+           settings.positionalError);
+    if (angular > settings.angularError ||
+        positional > settings.positionalError) {
+        printf("The error is over the limit\n");
+        return 1;
+    }
+    return 0;
+}
+
+// Returns a component that makes the penguin parts apply their own colors.
+Component *enableColorPenguin() {
+    return Component::function([]{ colorPenguin = true; });
+}
+
+// Returns a component that makes the penguin parts keep the current color.
+Component *disableColorPenguin() {
+    return Component::function([]{ colorPenguin = false; });
+}
+
+// Returns the components for the wireframe rendering mode.
+Component *wireFrameMode() {
+    Entity *mode = Component::entity();
+    mode->AddComponent(Component::disable(GL_LIGHTING));	// no lights
+    mode->AddComponent(Component::polygonMode(GL_FRONT_AND_BACK, GL_LINE)); // draw with just line
+    return mode;
+}
+
+// Returns the components for the solid rendering mode.
+Component *solidMode() {
+    Entity *mode = Component::entity();
+    mode->AddComponent(Component::disable(GL_LIGHTING)); // no lights
+    mode->AddComponent(Component::polygonMode(GL_FRONT_AND_BACK, GL_FILL)); // draw with filled cuboids 
+    return mode;
+}
+
+// Builds the pipeline that draws the given rig, e.g. PENGUIN, with the current
+// render settings in the current arena.
+Component *buildPipeline(Entity &rig) {
+    Wrapper &penguin = rig.wrap();
+
+    switch (renderStyle) {
+        case WIREFRAME:
+            penguin << enableColorPenguin() << wireFrameMode();
+            break;
+        case SOLID:
+            penguin << enableColorPenguin() << solidMode();
+            break;
+        case OUTLINED:
+            // Solid pass first, then the outlines on top of it in black.
+            penguin << Component::pushAttrib(GL_COLOR_BUFFER_BIT)
+                    << Component::enable(GL_POLYGON_OFFSET_FILL)
+                    << &(rig.wrap() << enableColorPenguin() << solidMode())
+                    << disableColorPenguin()
+                    << Component::color(0, 0, 0)
+                    << wireFrameMode()
+                    << Component::polygonOffset(1.0, 2.0)
+                    >> enableColorPenguin()
+                    >> Component::disable(GL_POLYGON_OFFSET_FILL)
+                    >> Component::popAttrib();
+            break;
+        case METAL:
+        case MATTE:
+            if (coloredMaterials)
+                penguin << Component::enable(GL_COLOR_MATERIAL);
+            penguin << Component::enable(GL_LIGHT0)
+                    << Component::enable(GL_LIGHTING)
+                    << Component::shadeModel(shadeModel == SHADE_FLAT ? GL_FLAT : GL_SMOOTH)
+                    << Component::polygonMode(GL_FRONT_AND_BACK, GL_FILL)
+                    << Component::light(GL_LIGHT0, GL_POSITION, light_pos)
+                    << Component::light(GL_LIGHT0, GL_SPECULAR, LIGHT_SPECULAR);
+            if (renderStyle == METAL) {
+                penguin << Component::material(GL_FRONT, GL_SPECULAR, METAL_SPECULAR)
+                        << Component::material(GL_FRONT, GL_AMBIENT_AND_DIFFUSE, METAL_DIFFUSE)
+                        << Component::material(GL_FRONT, GL_SHININESS, METAL_SHININESS);
+            } else {
+                penguin << Component::material(GL_FRONT, GL_SPECULAR, MATTE_SPECULAR)
+                        << Component::material(GL_FRONT, GL_AMBIENT_AND_DIFFUSE, MATTE_DIFFUSE)
+                        << Component::material(GL_FRONT, GL_SHININESS, MATTE_SHININESS);
+            }
+            penguin >> Component::disable(GL_LIGHTING)
+                    >> Component::disable(GL_LIGHT0);
+            if (coloredMaterials)
+                penguin >> Component::disable(GL_COLOR_MATERIAL);
+            break;
+    }
+
+    return &penguin;
+}
+
+// Compiles the given pipeline into @commands@ and folds it. Returns the number
+// of commands folded away.
+int compilePipeline(CommandBuffer &commands, Component *root) {
+    commands.Compile(root);
+
+    // The USELESS channels have no UI control and are zero in every
+    // keyframe, so the transforms they drive can be folded away.
+    std::vector<int> pinned;
+    pinned.push_back(Keyframe::USELESS);
+    pinned.push_back(Keyframe::BEAK_USElESS);
+    return commands.Fold(STATE.getDOFPtr(0), pinned);
+}
+
+// Returns the compiled pipeline for the current render settings, rebuilding it
+// only if one of the settings has changed since the last call.
+CommandBuffer &currentPipeline() {
+    if (pipeline == 0 ||
+        pipelineStyle != renderStyle ||
+        pipelineShade != shadeModel ||
+        pipelineColored != coloredMaterials) {
+        pipelineArena.Clear();
+        {
+            ArenaScope scope(pipelineArena);
+            pipeline = buildPipeline(PENGUIN);
+        }
+        compilePipeline(pipelineCommands, pipeline);
+        pipelineStyle = renderStyle;
+        pipelineShade = shadeModel;
+        pipelineColored = coloredMaterials;
+    }
+    return pipelineCommands;
+}
+
+
+// Writes the update at the given time to the back buffer of animationUpdates
+// and publishes it. @pose@ and @poseTime@ are the pose and animation time of
+// the update before, and become those of this one. Sampling with @cursor@.
+static void publishUpdate(double time, double step, float duration,
+                          ChannelCursor &cursor, Keyframe::Pose &pose,
+                          float &poseTime) {
+    // Loop the animation. Blending across the loop would sweep through every
+    // pose in between, so the first update of a loop is not blended with the
+    // last one.
+    AnimationUpdate &update = animationUpdates.Back();
+    float loopTime = duration > 0 ? float(fmod(time, duration)) : 0;
+    update.previous = pose;
+    pose = getInterpolatedJointDOFS(loopTime, &cursor);
+    if ( loopTime < poseTime )
+        update.previous = pose;
+    update.current = pose;
+    poseTime = loopTime;
+
+    update.time = time;
+    update.step = step;
+    update.poseTime = loopTime;
+    if ( crowd != 0 ) {
+        update.crowdTimes.resize(crowd->size());
+        update.crowdPoses.resize(crowd->size() * Keyframe::NUM_JOINT_ENUM);
+        if ( crowd->size() > 0 )
+            crowd->Pose(time, &update.crowdTimes[0], &update.crowdPoses[0]);
+    }
+    animationUpdates.Publish();
+}
+
+// Starts the animation thread at the current time of animationTimer. The
+// first update is done here, and taken right away, so that display() always
+// has one to draw; the next one is due one update period later. Everything
+// the thread samples is built first, so that it only reads it.
+void startAnimationThread() {
+    playbackChannels();
+    if ( playBakedPoses )
+        playbackPoses();
+
+    double time = animationTimer.elapsed();
+    double step = 1.0 / updateRate;
+    float duration = keyframes.duration();
+    ChannelCursor cursor;
+    Keyframe::Pose pose;
+    float poseTime = FLT_MAX;   // so that the first update starts a loop
+    publishUpdate(time, step, duration, cursor, pose, poseTime);
+    animationUpdates.Update();
+
+    animationThread = std::thread(animationLoop, time, step, duration, pose,
+                                  poseTime);
+}
+
+// Stops the animation thread, waiting for the update it may be doing. Returns
+// true if it was running. Whatever the thread reads may be changed after this,
+// before starting it again.
+bool stopAnimationThread() {
+    if ( !animationThread.joinable() )
+        return false;
+
     {
-        t0 = (keyframes[i].getDOFVector() - keyframes[i - 2].getDOFVector()) * 0.5;
-        t1 = keyframes[i].getDOFVector() - keyframes[i - 1].getDOFVector();
-    } else {
-        t0 = (keyframes[i].getDOFVector()   - keyframes[i - 2].getDOFVector()) * 0.5;
-        t1 = (keyframes[i + 1].getDOFVector() - keyframes[i - 1].getDOFVector()) * 0.5;
+        std::lock_guard<std::mutex> lock(animationMutex);
+        animationStopping = true;
     }
+    animationWake.notify_one();
+    animationThread.join();
+    animationStopping = false;
+    return true;
+}
 
-    // Return the interpolated Vector
-    Vector a0 = p0;
-    Vector a1 = t0;
-    Vector a2 = p0 * (-3) + p1 * 3 + t0 * (-2) + t1 * (-1);
-    Vector a3 = p0 * 2 + p1 * (-2) + t0 + t1;
+// Body of the animation thread. Publishes an update every @step@ seconds of
+// animationTimer after the one at @time@, with pose @pose@ at animation time
+// @poseTime@, until stopAnimationThread() is called, and sleeps in between.
+void animationLoop(double time, double step, float duration,
+                   Keyframe::Pose pose, float poseTime) {
+    ChannelCursor cursor;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(animationMutex);
+            double wait = time + step - animationTimer.elapsed();
+            if (wait > 0)
+                animationWake.wait_for(lock, std::chrono::duration<double>(wait),
+                                       []{ return animationStopping; });
+            if (animationStopping)
+                return;
+        }
+
+        time += step;
+        double now = animationTimer.elapsed();
+        if (now - time > MAX_UPDATES_BEHIND * step) {
+            // Too far behind; drop the updates that are left
+            time = now;
+        }
+        publishUpdate(time, step, duration, cursor, pose, poseTime);
+    }
+}
 
-    return (((a3 * time + a2) * time + a1) * time + a0);
+// Sets a GLUT timer for animate() at the next deadline of framePacer. GLUT
+// timers only count whole milliseconds, so this rounds up to be sure the
+// deadline has passed when the timer fires.
+void scheduleFrame() {
+    unsigned int msecs = (unsigned int) ceil(framePacer.remaining() * 1000);
+    glutTimerFunc(msecs, animate, animationRun);
 }
 
+// Timer callback for animating the scene
+void animate(int run) {
+    if ( run != animationRun )
+        return;
 
-// Callback idle function for animating the scene
-void animate() {
-    // Only update if enough time has passed
+    // Wait for the next frame in the event loop rather than here
     // (This locks the display to a certain frame rate rather
     //  than updating as fast as possible. The effect is that
     //  the animation should run at about the same rate
-    //  whether being run on a fast machine or slow machine)
-    if ( frameRateTimer.elapsed() > SEC_PER_FRAME ) {
-        // Tell glut window to update itself. This will cause the display()
-        // callback to be called, which renders the object (once you've written
-        // the callback).
-        glutSetWindow(windowID);
-        glutPostRedisplay();
+    //  whether being run on a fast machine or slow machine,
+    //  and input is still handled in between.)
+    int missed = framePacer.start();
+    scheduleFrame();
+    if ( missed < 0 )
+        return;
 
-        // Restart the frame rate timer
-        // for the next frame
-        frameRateTimer.reset();
+    // Show the pose of the latest update of the animation thread in the
+    // keyframe controls
+    if ( animationUpdates.Update() ) {
+        const AnimationUpdate &update = animationUpdates.Front();
+        STATE.setDOFVector(update.current);
+        STATE.setTime(update.poseTime);
+        glui_keyframe->sync_live();
     }
+
+    // Tell glut window to update itself. This will cause the display()
+    // callback to be called, which renders the object (once you've written
+    // the callback).
+    glutSetWindow(windowID);
+    glutPostRedisplay();
 }
 
 
@@ -1040,92 +1432,42 @@ void display(void) {
     // Specify camera transformation
     glTranslatef(camXPos, camYPos, camZPos);
 
-    // Get the time for the current animation step, if necessary
+    // Blend between the poses of the latest animation update, by how far the
+    // time is past it
+    const AnimationUpdate &update = animationUpdates.Front();
     if ( animate_mode ) {
-        float curTime = animationTimer.elapsed();
-        if ( curTime >= keyframes[maxValidKeyframe].getTime() ) {
-            // Restart the animation
-            animationTimer.reset();
-            curTime = animationTimer.elapsed();
-        }
-
-        STATE.setDOFVector( getInterpolatedJointDOFS(curTime) );
-        STATE.setTime(curTime);
-        glui_keyframe->sync_live();
+        float blend = float((animationTimer.elapsed() - update.time) / update.step);
+        blend = blend < 0 ? 0 : (blend > 1 ? 1 : blend);
+        Keyframe::Pose pose = update.previous;
+        pose += (update.current - update.previous) * blend;
+        STATE.setDOFVector(pose);
     }
 //--------------------------------------------------------------------------------
 // TODO FOR PENGUIN 
 
     glPushMatrix();
 
-    float light_pos[] = {LIGHT_CIRCLE_RADIUS * cosf(deg2rad(light_angle)),
-                         LIGHT_CIRCLE_RADIUS * sinf(deg2rad(light_angle)),
-                         25, 0};
-
-    const float METAL_SPECULAR[] = { 0.70, 0.70, 0.70, 1.0 };
-    const float METAL_DIFFUSE[]  = { 0.50, 0.50, 0.50, 1.0 };
-    const float METAL_SHININESS  = 128;
-
-    const float MATTE_SPECULAR[] = { 0.01, 0.01, 0.01, 1.0 };
-    const float MATTE_DIFFUSE[]  = { 0.50, 0.50, 0.50, 1.0 };
-    const float MATTE_SHININESS  = 0;
-
-    const float LIGHT_SPECULAR[] = { 0.8, 0.8, 0.8, 1.0 };
-
-    Component *penguin = 0;
-
-    // determine render style and set glPolygonMode appropriately
-    switch (renderStyle) {
-        case WIREFRAME:
-            penguin = &(PENGUIN.wrap() << ENABLE_COLOR_PENGUIN << &wireFrameMode);
-            break;
-        case SOLID:
-            penguin = &(PENGUIN.wrap() << ENABLE_COLOR_PENGUIN << &solidMode);
-            break;
-        case OUTLINED:
-            penguin = &(PENGUIN.wrap() << ENABLE_COLOR_PENGUIN << &solidMode);
-            penguin = (PENGUIN.wrap()
-                    << penguin
-                    << DISABLE_COLOR_PENGUIN
-                    << Component::color(0, 0, 0)
-                    << &wireFrameMode
-                    << Component::polygonOffset(1.0, 2.0)
-                    >> ENABLE_COLOR_PENGUIN)
-                .enableDisable(GL_POLYGON_OFFSET_FILL)
-                ->pushPopAttribute(GL_COLOR_BUFFER_BIT);
-            break;
-        case METAL:
-            glShadeModel(shadeModel == SHADE_FLAT ? GL_FLAT : GL_SMOOTH);
-            penguin = (PENGUIN.wrap()
-                    << Component::polygonMode(GL_FRONT_AND_BACK, GL_FILL)
-                    << Component::light(GL_LIGHT0, GL_POSITION, light_pos)
-                    << Component::light(GL_LIGHT0, GL_SPECULAR, LIGHT_SPECULAR)
-                    << Component::material(GL_FRONT, GL_SPECULAR, METAL_SPECULAR)
-                    << Component::material(GL_FRONT, GL_AMBIENT_AND_DIFFUSE, METAL_DIFFUSE)
-                    << Component::material(GL_FRONT, GL_SHININESS, METAL_SHININESS))
-                .enableDisable(GL_LIGHTING)
-                ->enableDisable(GL_LIGHT0);
-            if (coloredMaterials)
-                penguin = penguin->enableDisable(GL_COLOR_MATERIAL);
-            break;
-        case MATTE:
-            glShadeModel(shadeModel == SHADE_FLAT ? GL_FLAT : GL_SMOOTH);
-            penguin = (PENGUIN.wrap()
-                    << Component::polygonMode(GL_FRONT_AND_BACK, GL_FILL)
-                    << Component::light(GL_LIGHT0, GL_POSITION, light_pos)
-                    << Component::light(GL_LIGHT0, GL_SPECULAR, LIGHT_SPECULAR)
-                    << Component::material(GL_FRONT, GL_SPECULAR, MATTE_SPECULAR)
-                    << Component::material(GL_FRONT, GL_AMBIENT_AND_DIFFUSE, MATTE_DIFFUSE)
-                    << Component::material(GL_FRONT, GL_SHININESS, MATTE_SHININESS))
-                .enableDisable(GL_LIGHTING)
-                ->enableDisable(GL_LIGHT0);
-            if (coloredMaterials)
-                penguin = penguin->enableDisable(GL_COLOR_MATERIAL);
-            break;
+    // The pipeline reads the light position through a pointer, so it is
+    // enough to update it in place.
+    light_pos[0] = LIGHT_CIRCLE_RADIUS * cosf(deg2rad(light_angle));
+    light_pos[1] = LIGHT_CIRCLE_RADIUS * sinf(deg2rad(light_angle));
+
+    if (crowd != 0) {
+        Matrix view;
+        glGetFloatv(GL_MODELVIEW_MATRIX, view.m);
+        currentPipeline();
+
+        // While the animation runs, its thread computes the poses of the
+        // crowd; otherwise the crowd stays at the time of the last update.
+        if ( animate_mode )
+            crowd->Update(&update.crowdPoses[0], view);
+        else
+            crowd->Update(update.time, view);
+        crowd->Draw();
+    } else {
+        currentPipeline().Execute(STATE.getDOFPtr(0));
     }
 
-    penguin->Update();
-
 
 //--------------------------------------------------------------------------------
     glPopMatrix();
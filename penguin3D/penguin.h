@@ -0,0 +1,118 @@
+#ifndef PENGUIN_H
+#define PENGUIN_H
+
+#include "gl.h"
+
+// Needed on some compilers to inform them that we want to use M_PI or other math-related defines.
+#define _USE_MATH_DEFINES
+
+#include <math.h>
+
+#include "animation.h"
+#include "arena.h"
+#include "command.h"
+#include "component.h"
+#include "compressedtrack.h"
+#include "crowd.h"
+#include "keyframe.h"
+#include "keyframetext.h"
+#include <vector>
+
+// The penguin, its render pipelines and its keyframes, as penguin.cpp keeps
+// them for the user interface. The programs built from penguin.cpp share
+// them: the penguin itself (main.cpp), and the benchmarks (bench.cpp) and
+// checks (check.cpp) that run without a window.
+
+inline float deg2rad(float deg) { return deg * M_PI / 180; }
+
+// Window settings
+extern int Win[2];
+extern int windowID;                // Glut window ID (for display)
+extern char msg[256];               // String used for status message
+
+// Camera settings
+extern GLdouble camXPos;
+extern GLdouble camYPos;
+extern GLdouble camZPos;
+
+// Light settings
+extern float light_angle;
+const float LIGHT_CIRCLE_RADIUS = 100;
+extern float light_pos[4];          // updated in place from light_angle
+
+// Render settings
+enum { SHADE_FLAT, SHADE_SMOOTH };
+extern int shadeModel;
+
+enum {
+    WIREFRAME,
+    SOLID,
+    OUTLINED,
+    METAL,
+    MATTE
+} ;
+extern int renderStyle;
+extern int coloredMaterials;
+
+// Keyframe settings
+const char filenameKF[] = "keyframes.txt";  // file for loading / saving
+                                            // keyframes
+extern KeyframeTrack keyframes;             // list of keyframes, sorted by
+                                            // time (see animation.h)
+const float BAKE_RATE = 120.0;  // rows per second of the baked poses
+
+// Time settings
+const float SEC_PER_FRAME = 1.0 / 60.0;
+
+// An update of the animation (see animationLoop() in penguin.cpp).
+struct AnimationUpdate {
+    AnimationUpdate() : time(0), step(1), poseTime(0) {}
+
+    double time;                    // seconds of animationTimer
+    double step;                    // seconds until the next update
+    float poseTime;                 // animation time of @current@
+    Keyframe::Pose previous;        // poses at the update before and at this
+    Keyframe::Pose current;         // one, equal at the start of a loop
+    std::vector<float> crowdTimes;  // animation time and pose of every crowd
+    std::vector<float> crowdPoses;  // member (see Crowd::Pose)
+};
+
+// The pose the penguin is drawn in, and the penguin rig, owned by rigArena.
+extern Keyframe STATE;
+extern Arena rigArena;
+extern Entity &PENGUIN;
+
+// The compiled pipeline of PENGUIN for the current render settings (see
+// currentPipeline()).
+extern CommandBuffer pipelineCommands;
+
+// Crowd mode (see the --crowd option). The crowd replays pipelineCommands
+// once per member, each member in its own pose.
+extern int crowdSize;
+extern Crowd *crowd;
+const float CROWD_SPACING = 3.0;
+
+// Callbacks for handling events in glut
+void initGlui();
+void reshape(int w, int h);
+bool stopAnimationThread();
+void display(void); // The main function that displays the penguin
+void mouse(int button, int state, int x, int y); // Mouse event handler
+void motion(int x, int y);
+
+// Functions to help draw the object
+void buildPenguin();
+void buildPenguin(Entity &penguin);
+bool loadKeyframes(const char *filename, KeyframeTextError *error = 0);
+void keyframesChanged();
+void formatLoadError(char *out, const char *filename,
+                     const KeyframeTextError &error);
+int convertKeyframes(const char *from, const char *to);
+int compressKeyframes(const char *filename,
+                      const CompressionSettings &settings);
+void interpolatePoses(const float *times, int count, float *poses);
+Component *buildPipeline(Entity &rig);
+int compilePipeline(CommandBuffer &commands, Component *root);
+CommandBuffer &currentPipeline();
+
+#endif /* end of include guard: PENGUIN_H */
@@ -0,0 +1,151 @@
+#include "posetable.h"
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+// Largest quantized value.
+static const int QUANTIZED_MAX = 65535;
+
+// Returns @bytes@ rounded up to a whole number of cache lines.
+static size_t roundToCacheLine(size_t bytes) {
+    size_t mask = PoseTable::CACHE_LINE - 1;
+    return (bytes + mask) & ~mask;
+}
+
+PoseTable::PoseTable() : offsets_(), steps_(), storage_() {
+    Clear();
+}
+
+void PoseTable::Bake(const ChannelTrack &channels, float rate, bool quantize) {
+    const int dofs = Keyframe::NUM_JOINT_ENUM;
+    Clear();
+
+    // Sample the channels in one batch first, so that quantizing can look
+    // at all values of a DOF.
+    int rows = int(ceilf(channels.duration() * rate)) + 1;
+    std::vector<float> times(rows);
+    for (int i = 0; i < rows; i++)
+        times[i] = i / rate;
+    std::vector<float> poses(rows * dofs);
+    ChannelCursor cursor;
+    channels.Sample(&times[0], rows, &poses[0], &cursor);
+
+    rows_ = rows;
+    rate_ = rate;
+    quantized_ = quantize;
+    stride_ = roundToCacheLine(dofs * (quantize ? sizeof(uint16_t)
+                                                : sizeof(float)));
+    storage_.assign(rows * stride_ + CACHE_LINE - 1, 0);
+    first_ = (CACHE_LINE - uintptr_t(&storage_[0]) % CACHE_LINE) % CACHE_LINE;
+
+    if (!quantize) {
+        for (int i = 0; i < rows; i++)
+            memcpy(&storage_[first_ + i * stride_], &poses[i * dofs],
+                   dofs * sizeof(float));
+        return;
+    }
+
+    for (int d = 0; d < dofs; d++) {
+        float low = poses[d], high = poses[d];
+        for (int i = 1; i < rows; i++) {
+            low = fminf(low, poses[i * dofs + d]);
+            high = fmaxf(high, poses[i * dofs + d]);
+        }
+        offsets_[d] = low;
+        steps_[d] = (high - low) / QUANTIZED_MAX;
+    }
+
+    for (int i = 0; i < rows; i++) {
+        uint16_t *values =
+            reinterpret_cast<uint16_t *>(&storage_[first_ + i * stride_]);
+        for (int d = 0; d < dofs; d++) {
+            float value = poses[i * dofs + d];
+            long q = steps_[d] > 0 ? lrintf((value - offsets_[d]) / steps_[d]) : 0;
+            q = q < 0 ? 0 : (q > QUANTIZED_MAX ? QUANTIZED_MAX : q);
+            values[d] = uint16_t(q);
+
+            float error = fabsf(offsets_[d] + steps_[d] * values[d] - value);
+            if (error > maxError_)
+                maxError_ = error;
+        }
+    }
+}
+
+void PoseTable::Clear() {
+    rows_ = 0;
+    rate_ = 0;
+    quantized_ = false;
+    stride_ = 0;
+    maxError_ = 0;
+    storage_.clear();
+    first_ = 0;
+}
+
+int PoseTable::rows() const {
+    return rows_;
+}
+
+float PoseTable::rate() const {
+    return rate_;
+}
+
+bool PoseTable::quantized() const {
+    return quantized_;
+}
+
+size_t PoseTable::bytes() const {
+    return rows_ * stride_;
+}
+
+float PoseTable::maxError() const {
+    return maxError_;
+}
+
+const char *PoseTable::row(int i) const {
+    return &storage_[first_ + i * stride_];
+}
+
+void PoseTable::samplePose(float time, float *pose) const {
+    const int dofs = Keyframe::NUM_JOINT_ENUM;
+    if (rows_ == 0) {
+        memcpy(pose, Keyframe().getDOFVector().getData(), dofs * sizeof(float));
+        return;
+    }
+
+    // Blend between rows @i@ and @i + 1@, or use the first or last row.
+    float position = time * rate_;
+    int i = 0;
+    float t = 0;
+    if (position >= rows_ - 1) {
+        i = rows_ - 1;
+    } else if (position > 0) {
+        i = int(position);
+        t = position - i;
+    }
+    int next = i + 1 < rows_ ? i + 1 : i;
+
+    if (!quantized_) {
+        const float *a = reinterpret_cast<const float *>(row(i));
+        const float *b = reinterpret_cast<const float *>(row(next));
+        for (int d = 0; d < dofs; d++)
+            pose[d] = a[d] + (b[d] - a[d]) * t;
+    } else {
+        const uint16_t *a = reinterpret_cast<const uint16_t *>(row(i));
+        const uint16_t *b = reinterpret_cast<const uint16_t *>(row(next));
+        for (int d = 0; d < dofs; d++) {
+            float q = a[d] + (float(b[d]) - a[d]) * t;
+            pose[d] = offsets_[d] + steps_[d] * q;
+        }
+    }
+}
+
+Keyframe::Pose PoseTable::Sample(float time) const {
+    Keyframe::Pose pose;
+    samplePose(time, pose.getData());
+    return pose;
+}
+
+void PoseTable::Sample(const float *times, int count, float *poses) const {
+    for (int i = 0; i < count; i++)
+        samplePose(times[i], poses + i * Keyframe::NUM_JOINT_ENUM);
+}
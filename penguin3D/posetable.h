@@ -0,0 +1,85 @@
+#ifndef POSETABLE_H
+#define POSETABLE_H
+
+#include <stddef.h>
+#include <vector>
+#include "channeltrack.h"
+
+// A PoseTable holds an animation baked into poses sampled at a fixed rate, so
+// that playing it back is a lookup and a linear blend between two rows rather
+// than a keyframe search and a spline per DOF. Looping playback evaluates the
+// same splines over and over; baking evaluates them once.
+//
+// The rows are poses of Keyframe::NUM_JOINT_ENUM values, one after the other
+// in one block. Each row starts on a cache line and is padded to a whole
+// number of them, so that a blend reads no more lines than it needs. Rows are
+// stored as floats, or quantized to 16 bits per DOF between the smallest and
+// largest value of the DOF; a quantized row fits in one cache line.
+class PoseTable {
+    public:
+        enum { CACHE_LINE = 64 };
+
+        PoseTable();
+
+        // Replaces the rows with the poses of the channels every 1 / @rate@
+        // seconds, from 0 up to the first row at or after their duration.
+        void Bake(const ChannelTrack &channels, float rate, bool quantize);
+
+        // Removes all rows.
+        void Clear();
+
+        // Number of rows.
+        int rows() const;
+
+        // Rows per second.
+        float rate() const;
+
+        // True if the rows are quantized to 16 bits per DOF.
+        bool quantized() const;
+
+        // Bytes taken by the rows, including their padding.
+        size_t bytes() const;
+
+        // Largest difference between a value of the rows and the value
+        // sampled from the channels when baking. This is the quantization
+        // error, and 0 for rows of floats; it does not include the error of
+        // blending between rows.
+        float maxError() const;
+
+        // Returns the pose at the given time, blended linearly between the
+        // rows before and after it. Times outside the table give the first
+        // or last row, and an empty table gives the default pose.
+        Keyframe::Pose Sample(float time) const;
+
+        // Writes the poses at @count@ times to @poses@, one pose of
+        // @Keyframe::NUM_JOINT_ENUM@ values after the other.
+        void Sample(const float *times, int count, float *poses) const;
+
+    private:
+        PoseTable(const PoseTable &);
+        PoseTable &operator =(const PoseTable &);
+
+        // Writes the pose at the given time to @pose@.
+        void samplePose(float time, float *pose) const;
+
+        // Returns the start of row @i@.
+        const char *row(int i) const;
+
+        int rows_;
+        float rate_;
+        bool quantized_;
+        size_t stride_;     // bytes from one row to the next
+        float maxError_;
+
+        // A quantized value @q@ of DOF @d@ stands for
+        // @offsets_[d] + steps_[d] * q@.
+        Keyframe::Pose offsets_;
+        Keyframe::Pose steps_;
+
+        // The rows start at @storage_[first_]@, the first cache line of the
+        // storage.
+        std::vector<char> storage_;
+        size_t first_;
+};
+
+#endif /* end of include guard: POSETABLE_H */
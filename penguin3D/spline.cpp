@@ -0,0 +1,151 @@
+#include "spline.h"
+
+// The SSE2 and AVX2 kernels are compiled with target attributes rather than
+// compiler flags, so that the rest of the program still runs on any CPU and
+// the kernel is picked at runtime.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SPLINE_X86 1
+#include <immintrin.h>
+#endif
+
+typedef void (*SplineKernel)(const SplineSegment &segment, float t,
+                             int first, int count, float *out);
+
+// The vector kernels below must do the same operations in the same order as
+// evaluateAt (see spline.h).
+
+// Each kernel evaluates the values from @first@ to @count@.
+static void evaluateScalar(const SplineSegment &s, float t, int first,
+                           int count, float *out) {
+    for (int i = first; i < count; i++)
+        out[i] = evaluateAt(s, t, i);
+}
+
+#ifdef SPLINE_X86
+
+__attribute__((target("sse2")))
+static void evaluateSse2(const SplineSegment &s, float t, int first,
+                         int count, float *out) {
+    const __m128 vt = _mm_set1_ps(t);
+    const __m128 s0 = _mm_set1_ps(s.s0);
+    const __m128 s1 = _mm_set1_ps(s.s1);
+    const __m128 minus3 = _mm_set1_ps(-3), plus3 = _mm_set1_ps(3);
+    const __m128 minus2 = _mm_set1_ps(-2), plus2 = _mm_set1_ps(2);
+    const __m128 minus1 = _mm_set1_ps(-1);
+
+    int i = first;
+    for (; i + 4 <= count; i += 4) {
+        __m128 p0 = _mm_loadu_ps(s.p0 + i);
+        __m128 p1 = _mm_loadu_ps(s.p1 + i);
+        __m128 t0 = _mm_mul_ps(_mm_sub_ps(p1, _mm_loadu_ps(s.prev + i)), s0);
+        __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(s.next + i), p0), s1);
+
+        __m128 a2 = _mm_add_ps(_mm_mul_ps(p0, minus3), _mm_mul_ps(p1, plus3));
+        a2 = _mm_add_ps(a2, _mm_mul_ps(t0, minus2));
+        a2 = _mm_add_ps(a2, _mm_mul_ps(t1, minus1));
+        __m128 a3 = _mm_add_ps(_mm_mul_ps(p0, plus2), _mm_mul_ps(p1, minus2));
+        a3 = _mm_add_ps(_mm_add_ps(a3, t0), t1);
+
+        __m128 r = _mm_add_ps(_mm_mul_ps(a3, vt), a2);
+        r = _mm_add_ps(_mm_mul_ps(r, vt), t0);
+        r = _mm_add_ps(_mm_mul_ps(r, vt), p0);
+        _mm_storeu_ps(out + i, r);
+    }
+    evaluateScalar(s, t, i, count, out);
+}
+
+// Evaluates the segment at the 8 indices from @i@, reading and writing only
+// those selected by @mask@.
+__attribute__((target("avx2")))
+static inline void evaluateAvx2At(const SplineSegment &s, __m256 t, int i,
+                                  __m256i mask, float *out) {
+    const __m256 minus3 = _mm256_set1_ps(-3), plus3 = _mm256_set1_ps(3);
+    const __m256 minus2 = _mm256_set1_ps(-2), plus2 = _mm256_set1_ps(2);
+    const __m256 minus1 = _mm256_set1_ps(-1);
+
+    __m256 p0 = _mm256_maskload_ps(s.p0 + i, mask);
+    __m256 p1 = _mm256_maskload_ps(s.p1 + i, mask);
+    __m256 t0 = _mm256_sub_ps(p1, _mm256_maskload_ps(s.prev + i, mask));
+    t0 = _mm256_mul_ps(t0, _mm256_set1_ps(s.s0));
+    __m256 t1 = _mm256_sub_ps(_mm256_maskload_ps(s.next + i, mask), p0);
+    t1 = _mm256_mul_ps(t1, _mm256_set1_ps(s.s1));
+
+    __m256 a2 = _mm256_add_ps(_mm256_mul_ps(p0, minus3), _mm256_mul_ps(p1, plus3));
+    a2 = _mm256_add_ps(a2, _mm256_mul_ps(t0, minus2));
+    a2 = _mm256_add_ps(a2, _mm256_mul_ps(t1, minus1));
+    __m256 a3 = _mm256_add_ps(_mm256_mul_ps(p0, plus2), _mm256_mul_ps(p1, minus2));
+    a3 = _mm256_add_ps(_mm256_add_ps(a3, t0), t1);
+
+    __m256 r = _mm256_add_ps(_mm256_mul_ps(a3, t), a2);
+    r = _mm256_add_ps(_mm256_mul_ps(r, t), t0);
+    r = _mm256_add_ps(_mm256_mul_ps(r, t), p0);
+    _mm256_maskstore_ps(out + i, mask, r);
+}
+
+__attribute__((target("avx2")))
+static void evaluateAvx2(const SplineSegment &s, float t, int first,
+                         int count, float *out) {
+    const __m256 vt = _mm256_set1_ps(t);
+    const __m256i all = _mm256_set1_epi32(-1);
+
+    int i = first;
+    for (; i + 8 <= count; i += 8)
+        evaluateAvx2At(s, vt, i, all, out);
+
+    // The rest with one masked step, e.g. the last 7 of 31 DOFs. Masked
+    // loads never touch the values past @count@.
+    if (i < count) {
+        __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(count - i), lanes);
+        evaluateAvx2At(s, vt, i, mask, out);
+    }
+}
+
+#endif
+
+static const SplineKernel KERNELS[SIMD_LEVEL_COUNT] = {
+    evaluateScalar,
+#ifdef SPLINE_X86
+    evaluateSse2,
+    evaluateAvx2,
+#else
+    evaluateScalar,
+    evaluateScalar,
+#endif
+};
+
+static const char *const NAMES[SIMD_LEVEL_COUNT] = { "scalar", "sse2", "avx2" };
+
+SimdLevel supportedSimdLevel() {
+#ifdef SPLINE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return SIMD_AVX2;
+    if (__builtin_cpu_supports("sse2"))
+        return SIMD_SSE2;
+#endif
+    return SIMD_SCALAR;
+}
+
+// Selected once at startup, so that evaluateSpline never has to check.
+static SimdLevel selectedLevel = supportedSimdLevel();
+
+SimdLevel simdLevel() {
+    return selectedLevel;
+}
+
+bool selectSimdLevel(SimdLevel level) {
+    if (level < SIMD_SCALAR || level > supportedSimdLevel())
+        return false;
+    selectedLevel = level;
+    return true;
+}
+
+const char *simdLevelName(SimdLevel level) {
+    return NAMES[level];
+}
+
+void evaluateSpline(const SplineSegment &segment, float t, int count,
+                    float *out) {
+    KERNELS[selectedLevel](segment, t, 0, count, out);
+}
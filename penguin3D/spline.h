@@ -0,0 +1,57 @@
+#ifndef SPLINE_H
+#define SPLINE_H
+
+// A segment of a Catmull-Rom spline through arrays of values, e.g. poses.
+//
+// The segment goes from @p0@ to @p1@ with tangent @(p1 - prev) * s0@ at @p0@
+// and @(next - p0) * s1@ at @p1@. Inside a spline @prev@ and @next@ are the
+// neighbouring points and both scales are 0.5; at the ends of the spline the
+// missing neighbour is replaced by the point itself with a scale of 1.
+struct SplineSegment {
+    const float *prev;
+    const float *p0;
+    const float *p1;
+    const float *next;
+    float s0;
+    float s1;
+};
+
+// Instruction sets the spline kernel can use, from slowest to fastest.
+enum SimdLevel { SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2, SIMD_LEVEL_COUNT };
+
+// Evaluates @count@ values of the segment at @t@ in [0, 1] into @out@.
+//
+// The values are computed with the instruction set selected below, the best
+// one the CPU supports unless told otherwise. All of them do the same
+// operations in the same order (and no fused multiply-adds), so they give the
+// same results as the scalar code.
+void evaluateSpline(const SplineSegment &segment, float t, int count,
+                    float *out);
+
+// Evaluates value @i@ of the segment at @t@ in [0, 1]. This is what
+// evaluateSpline computes for every value, inline for when only a few values
+// are needed.
+inline float evaluateAt(const SplineSegment &s, float t, int i) {
+    float p0 = s.p0[i];
+    float p1 = s.p1[i];
+    float t0 = (p1 - s.prev[i]) * s.s0;
+    float t1 = (s.next[i] - p0) * s.s1;
+    float a2 = p0 * (-3) + p1 * 3 + t0 * (-2) + t1 * (-1);
+    float a3 = p0 * 2 + p1 * (-2) + t0 + t1;
+    return ((a3 * t + a2) * t + t0) * t + p0;
+}
+
+// Returns the best instruction set the CPU supports.
+SimdLevel supportedSimdLevel();
+
+// Returns the instruction set evaluateSpline uses.
+SimdLevel simdLevel();
+
+// Makes evaluateSpline use the given instruction set.
+// Returns false, and changes nothing, if the CPU does not support it.
+bool selectSimdLevel(SimdLevel level);
+
+// Returns the name of the given instruction set, e.g. "avx2".
+const char *simdLevelName(SimdLevel level);
+
+#endif /* end of include guard: SPLINE_H */
@@ -8,14 +8,22 @@
 			Provides a timer to drive the animation based
 			on time rather than frame rate.
 
+		FramePacer class
+			Tells when the next frame is due, so that the
+			animation runs at a fixed frame rate without
+			polling the timer.
+
 ***********************************************************/
 
 #ifndef __TIMER_H__
 #define __TIMER_H__
 
-#include <time.h>
+#include <chrono>
 
 
+// Measures wall time with the monotonic clock, which does not jump when the
+// system time is set and, unlike clock(), keeps counting while the process
+// sleeps or waits for the CPU.
 class Timer
 {
 public:
@@ -27,14 +35,85 @@ public:
 	virtual ~Timer() {}
 
 	// start the timer
-	void reset() { startTime = clock(); }
+	void reset() { startTime = std::chrono::steady_clock::now(); }
+
+	// query elapsed time, in seconds
+	double elapsed() const
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	}
+
+private:
+
+	std::chrono::steady_clock::time_point startTime;
+
+};
+
+
+// Paces frames to a fixed period: frame deadlines are a whole number of
+// periods after the pacer was reset. The caller waits for remaining() seconds,
+// e.g. with a GLUT timer so that events are still handled meanwhile, and then
+// starts the frame with start().
+//
+// A frame that starts a period or more after its deadline misses the
+// deadlines in between. The pacer then skips to the first deadline still
+// ahead rather than running the missed frames back to back, and counts every
+// deadline it skipped.
+class FramePacer
+{
+public:
+
+	// constructor
+	explicit FramePacer(double period) :
+		framePeriod(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(period)))
+	{
+		reset();
+	}
+
+	// starts pacing from now; the first deadline is one period away
+	void reset()
+	{
+		deadline = std::chrono::steady_clock::now() + framePeriod;
+		frameCount = 0;
+		missedCount = 0;
+	}
+
+	// seconds until the next deadline, or 0 if it has passed
+	double remaining() const
+	{
+		std::chrono::steady_clock::duration left = deadline - std::chrono::steady_clock::now();
+		return left.count() > 0 ? std::chrono::duration<double>(left).count() : 0;
+	}
+
+	// starts the frame of the deadline that passed last, and returns the
+	// number of deadlines skipped before it (0 if the frame is on time);
+	// returns -1, and changes nothing, if the next deadline has not passed
+	int start()
+	{
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if ( now < deadline )
+			return -1;
+		int missed = int((now - deadline) / framePeriod);
+		deadline += framePeriod * (missed + 1);
+
+		frameCount++;
+		missedCount += missed;
+		return missed;
+	}
+
+	// seconds between deadlines
+	double period() const { return std::chrono::duration<double>(framePeriod).count(); }
 
-	// query elapsed time
-	double elapsed() const { return (double(clock() - startTime) / double(CLOCKS_PER_SEC)); }
+	// frames started, and deadlines missed, since the last reset
+	int frames() const { return frameCount; }
+	int missed() const { return missedCount; }
 
 private:
 
-	clock_t startTime;
+	std::chrono::steady_clock::duration framePeriod;
+	std::chrono::steady_clock::time_point deadline;
+	int frameCount;
+	int missedCount;
 
 };
 
@@ -0,0 +1,65 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+
+// A TripleBuffer hands values of type @T@ from one writer thread to one reader
+// thread without locks, and without either side ever waiting for the other.
+//
+// Of its three buffers, the writer owns one (the back buffer) and the reader
+// owns one (the front buffer). The third one (the middle buffer) holds the
+// last value the writer published. Publishing and taking swap the middle
+// buffer with the back or front one in a single atomic exchange, so each
+// buffer is only ever touched by one thread at a time, and the reader always
+// sees a whole value, never one the writer is still writing. If the writer
+// publishes faster than the reader takes, the values in between are dropped;
+// if slower, the reader keeps the last one.
+//
+// The buffers are reused: the back buffer holds an old value, not the last
+// one written, so the writer must write the whole value every time. A @T@
+// that owns memory, e.g. a std::vector, keeps it from one use to the next, so
+// handing off values of the same size allocates nothing.
+template <typename T>
+class TripleBuffer {
+    public:
+        TripleBuffer() : middle_(1), back_(0), front_(2) {}
+
+        // Writer: the buffer to write the next value into.
+        T &Back() { return buffers_[back_]; }
+
+        // Writer: publishes the back buffer as the latest value, and takes
+        // the middle buffer as the new back buffer.
+        void Publish() {
+            back_ = middle_.exchange(back_ | FRESH, std::memory_order_acq_rel) &
+                    INDEX;
+        }
+
+        // Reader: takes the latest value if one was published since the last
+        // call, and returns true if so. Returns false, keeping the front
+        // buffer, otherwise.
+        bool Update() {
+            if ((middle_.load(std::memory_order_relaxed) & FRESH) == 0)
+                return false;
+            front_ = middle_.exchange(front_, std::memory_order_acq_rel) &
+                     INDEX;
+            return true;
+        }
+
+        // Reader: the latest value taken by Update().
+        const T &Front() const { return buffers_[front_]; }
+
+    private:
+        TripleBuffer(const TripleBuffer &);
+        TripleBuffer &operator =(const TripleBuffer &);
+
+        // The middle buffer is @middle_ & INDEX@. It is FRESH if the writer
+        // published it and the reader did not take it yet.
+        enum { INDEX = 3, FRESH = 4 };
+
+        T buffers_[3];
+        std::atomic<int> middle_;
+        int back_;
+        int front_;
+};
+
+#endif /* end of include guard: TRIPLEBUFFER_H */